@@ -3,6 +3,14 @@
 #include "openMVG/features/akaze/image_describer_akaze.hpp"
 #include "openMVG/features/akaze/mldb_descriptor.hpp"
 
+#include "coloc/KeypointBudget.hpp"
+#include "coloc/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+#include <vector>
+
 using namespace openMVG::features;
 
 float GetfDescFactor()
@@ -10,9 +18,49 @@ float GetfDescFactor()
 	return 11.f*sqrtf(2.f);
 }
 
+// Packs the MLDB bits, one bool each, into 'length' bytes: bit i of byte j is entry 8 * j + i
+inline void packMLDB(const bool* const bits, unsigned char* const packed, const size_t length)
+{
+	static_assert(sizeof(bool) == 1, "MLDB packing expects one byte per bool");
+	constexpr int numBits = 486;
+	int i = 0;
+	for (; i + 16 <= numBits; i += 16) {
+		// the bools are 0 or 1, shift that bit to the top of each byte for movemask
+		const __m128i v = _mm_slli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + i)), 7);
+		const uint16_t word = static_cast<uint16_t>(_mm_movemask_epi8(v));
+		memcpy(packed + i / 8, &word, sizeof(word));
+	}
+	unsigned char tail = 0;
+	for (int b = 0; i + b < numBits; ++b)
+		tail |= static_cast<unsigned char>(bits[i + b]) << b;
+	packed[i / 8] = tail;
+	memset(packed + i / 8 + 1, 0, length - (i / 8 + 1));
+}
+
+// State of describe_AKAZE kept from one frame to the next, one per drone. The nonlinear scale
+// space is not part of it: openMVG's AKAZE object keeps its slices private and builds them anew
+// for every image.
+struct AKAZEWorkspace
+{
+	AKAZE_Image_describer::Params params;
+	std::vector<AKAZEKeypoint> kpts;
+	// Keypoint budget, see applyKeypointBudget
+	size_t maxkp;
+	unsigned int budgetGrid;
+	// Keypoints found in the last image, before the budget
+	size_t detected = 0;
+
+	AKAZEWorkspace(size_t _maxkp = 0, unsigned int _budgetGrid = 8) : maxkp(_maxkp), budgetGrid(_budgetGrid)
+	{
+		params.options_.fDesc_factor = GetfDescFactor();
+		kpts.reserve(5000);
+	}
+};
+
 std::unique_ptr<AKAZE_Image_describer_MLDB::Regions_type>
 describe_AKAZE
 (
+	AKAZEWorkspace& workspace,
 	const image::Image<unsigned char>& image,
 	const image::Image<unsigned char>* mask = nullptr
 )
@@ -22,14 +70,10 @@ describe_AKAZE
 	if (image.size() == 0)
 		return regions;
 
-	AKAZE_Image_describer::Params params;
-
-	params.options_.fDesc_factor = GetfDescFactor();
-
-	AKAZE akaze(image, params.options_);
+	AKAZE akaze(image, workspace.params.options_);
 	akaze.Compute_AKAZEScaleSpace();
-	std::vector<AKAZEKeypoint> kpts;
-	kpts.reserve(5000);
+	std::vector<AKAZEKeypoint>& kpts = workspace.kpts;
+	kpts.clear();
 	akaze.Feature_Detection(kpts);
 	akaze.Do_Subpixel_Refinement(kpts);
 
@@ -43,39 +87,36 @@ describe_AKAZE
 	}),
 		kpts.end());
 
+	workspace.detected = kpts.size();
+
+	// Only a well spread subset is described and matched
+	coloc::applyKeypointBudget(kpts, workspace.maxkp, static_cast<float>(image.Width()), static_cast<float>(image.Height()), workspace.budgetGrid,
+		[](const AKAZEKeypoint& pt) { return coloc::BudgetPoint{ pt.x, pt.y, pt.response }; });
+
 	regions->Features().resize(kpts.size());
 	regions->Descriptors().resize(kpts.size());
 
-#ifdef OPENMVG_USE_OPENMP
-#pragma omp parallel for
-#endif
-	for (int i = 0; i < static_cast<int>(kpts.size()); ++i) {
-		AKAZEKeypoint ptAkaze = kpts[i];
+	// Orientation and description on the shared pool, in chunks of keypoints
+	constexpr size_t chunk = 64;
+	const size_t numChunks = (kpts.size() + chunk - 1) / chunk;
+	coloc::ThreadPool::instance().parallelFor(0, numChunks, [&](size_t n) {
+		Descriptor<bool, 486> desc;
+		const size_t end = std::min(kpts.size(), (n + 1) * chunk);
+		for (size_t i = n * chunk; i < end; ++i) {
+			AKAZEKeypoint ptAkaze = kpts[i];
 
-		const TEvolution& cur_slice = akaze.getSlices()[ptAkaze.class_id];
+			const TEvolution& cur_slice = akaze.getSlices()[ptAkaze.class_id];
 
-		akaze.Compute_Main_Orientation(ptAkaze, cur_slice.Lx, cur_slice.Ly);
+			akaze.Compute_Main_Orientation(ptAkaze, cur_slice.Lx, cur_slice.Ly);
 
-		regions->Features()[i] =
-			SIOPointFeature(ptAkaze.x, ptAkaze.y, ptAkaze.size, ptAkaze.angle);
+			regions->Features()[i] =
+				SIOPointFeature(ptAkaze.x, ptAkaze.y, ptAkaze.size, ptAkaze.angle);
 
-		// Compute MLDB descriptor
-		Descriptor<bool, 486> desc;
-		ComputeMLDBDescriptor(cur_slice.cur, cur_slice.Lx, cur_slice.Ly,
-			ptAkaze.octave, regions->Features()[i], desc);
-		// convert the bool vector to the binary unsigned char array
-		unsigned char* ptr = reinterpret_cast<unsigned char*>(&regions->Descriptors()[i]);
-		memset(ptr, 0, regions->DescriptorLength() * sizeof(unsigned char));
-		// For each byte
-		for (int j = 0; j < std::ceil(486. / 8.); ++j, ++ptr)
-		{
-			// set the corresponding 8bits to the good values
-			for (int iBit = 0; iBit < 8 && j * 8 + iBit < 486; ++iBit)
-			{
-				*ptr |= desc[j * 8 + iBit] << iBit;
-			}
+			// openMVG only writes MLDB descriptors as one bool per bit, so they are packed right after
+			ComputeMLDBDescriptor(cur_slice.cur, cur_slice.Lx, cur_slice.Ly,
+				ptAkaze.octave, regions->Features()[i], desc);
+			packMLDB(&desc[0], reinterpret_cast<unsigned char*>(&regions->Descriptors()[i]), regions->DescriptorLength());
 		}
-	}
+	});
 	return regions;
 }
-
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "coloc/BoundedQueue.hpp"
+#include "coloc/ThreadPool.hpp"
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace coloc
+{
+	// Runs 'process' on a background thread for every submitted request.
+	// Requests are taken by value so the caller hands over a snapshot and keeps
+	// working; finished results are collected with poll() whenever convenient.
+	template <typename Request, typename Result>
+	class AsyncWorker
+	{
+	public:
+		AsyncWorker(std::function<Result(Request&)> _process, size_t maxPending = 1)
+			: process(_process), requests(maxPending)
+		{
+			worker = std::thread([this]() {
+				Request request;
+				while (requests.pop(request)) {
+#ifdef OPENMVG_USE_OPENMP
+					// openMVG's OpenMP loops only get the threads the pool leaves idle, like Ceres
+					omp_set_num_threads(static_cast<int>(ThreadPool::instance().availableThreads()));
+#endif
+					Result result = process(request);
+					std::lock_guard<std::mutex> lock(resultMutex);
+					results.push_back(std::move(result));
+				}
+			});
+		}
+
+		~AsyncWorker()
+		{
+			finish();
+		}
+
+		// Returns false, dropping the request, if the worker is still busy with earlier ones
+		bool submit(Request request)
+		{
+			return requests.tryPush(std::move(request));
+		}
+
+		bool poll(Result& result)
+		{
+			std::lock_guard<std::mutex> lock(resultMutex);
+			if (results.empty())
+				return false;
+
+			result = std::move(results.front());
+			results.pop_front();
+			return true;
+		}
+
+		// Completes all queued requests and stops the thread; results stay available to poll()
+		void finish()
+		{
+			requests.close();
+			if (worker.joinable())
+				worker.join();
+		}
+
+	private:
+		std::function<Result(Request&)> process;
+		BoundedQueue<Request> requests;
+		std::deque<Result> results;
+		std::mutex resultMutex;
+		std::thread worker;
+	};
+}
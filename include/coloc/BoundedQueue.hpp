@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace coloc
+{
+	// Fixed-capacity FIFO connecting two pipeline stages. push() blocks while the
+	// queue is full, which throttles the producer to the speed of the consumer.
+	template <typename T>
+	class BoundedQueue
+	{
+	public:
+		explicit BoundedQueue(size_t _capacity) : capacity(_capacity > 0 ? _capacity : 1)
+		{ }
+
+		// Returns false if the queue was closed before the item could be queued
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+			if (closed)
+				return false;
+
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		// Returns false once the queue is closed and fully drained
+		bool pop(T& item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+			if (items.empty())
+				return false;
+
+			item = std::move(items.front());
+			items.pop_front();
+			notFull.notify_one();
+			return true;
+		}
+
+		// Non-blocking variants; return false instead of waiting
+		bool tryPush(T item)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (closed || items.size() >= capacity)
+				return false;
+
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		bool tryPop(T& item)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (items.empty())
+				return false;
+
+			item = std::move(items.front());
+			items.pop_front();
+			notFull.notify_one();
+			return true;
+		}
+
+		// Producers stop being accepted; consumers drain what is left
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+		size_t size()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return items.size();
+		}
+
+	private:
+		const size_t capacity;
+		bool closed = false;
+		std::deque<T> items;
+		std::mutex mutex;
+		std::condition_variable notFull, notEmpty;
+	};
+}
@@ -14,6 +14,12 @@
 #include "coloc/colocParams.hpp"
 #include "coloc/colocData.hpp"
 #include "coloc/AKAZE.hpp"
+#include "coloc/DetectionROI.hpp"
+#include "coloc/FeatureCache.hpp"
+#include "coloc/ThresholdController.hpp"
+
+#include <map>
+#include <mutex>
 
 using namespace openMVG;
 
@@ -25,23 +31,69 @@ namespace coloc
 	private:
 		std::unique_ptr<features::Image_describer> image_describer;
 
+		// AKAZE parameters and keypoint buffer of each drone, reused by all its frames
+		std::map<unsigned int, std::unique_ptr<AKAZEWorkspace>> workspaces;
+		std::mutex workspacesMutex;
+		const unsigned int maxkp;
+		const unsigned int budgetGrid;
+		// AKAZE detector threshold of each drone
+		DroneThresholds thresholds;
+		FeatureCache cache;
+
+		AKAZEWorkspace& workspace(unsigned int idx)
+		{
+			std::lock_guard<std::mutex> lock(workspacesMutex);
+			std::unique_ptr<AKAZEWorkspace>& ws = workspaces[idx];
+			if (!ws)
+				ws.reset(new AKAZEWorkspace(maxkp, budgetGrid));
+			return *ws;
+		}
+
 	public:
-		CPUDetector(DetectorOptions opts)
+		CPUDetector(DetectorOptions opts) : maxkp(opts.maxkp), budgetGrid(opts.budget_grid),
+			thresholds(AKAZE::Params().fThreshold, AKAZE::Params().fThreshold / 20.f, AKAZE::Params().fThreshold * 20.f, opts.target_kp),
+			cache(opts.feature_cache)
 		{
 			image_describer = features::AKAZE_Image_describer::create(features::AKAZE_Image_describer::Params(features::AKAZE::Params(), features::AKAZE_MLDB), true);
 			image_describer->Set_configuration_preset(features::NORMAL_PRESET);
 		}
 
-		T detectFeaturesFile(unsigned int idx, FeatureMap &regions, std::string &imageName)
+		// 'decoded', if given, is imageName already read into memory, e.g. by a FramePrefetcher,
+		// and a non-zero 'contentHash' its FeatureCache::contentHash
+		T detectFeaturesFile(unsigned int idx, FeatureMap &regions, std::string &imageName, const std::vector<ImageWindow> &windows = {}, const GrayImage *decoded = nullptr, uint64_t contentHash = 0)
 		{
-			image::Image<unsigned char> imageGray;
 			std::cout << imageName << std::endl;
+			ThresholdController& threshold = thresholds[idx];
+
+			// An image detected before with the same settings is read back from the cache
+			std::string cacheKey;
+			if (cache.enabled()) {
+				const std::string configuration = FeatureCache::configuration("AKAZE-MLDB " + std::to_string(maxkp) + " " + std::to_string(budgetGrid), threshold.value(), windows);
+				cacheKey = contentHash ? cache.key(contentHash, configuration) : cache.key(imageName, configuration);
+				uint64_t detected;
+				if (!cacheKey.empty() && cache.load(cacheKey, regions[idx], detected)) {
+					threshold.update(detected);
+					return EXIT_SUCCESS;
+				}
+			}
 
-			if (!ReadImage(imageName.c_str(), &imageGray)) {
+			image::Image<unsigned char> imageGray;
+			if (!decoded && !ReadImage(imageName.c_str(), &imageGray)) {
 				std::cout << "Unable to read image from the given path." << std::endl;
 			}
 
-			regions[idx] = describe_AKAZE(imageGray);
+			const size_t detected = detect(idx, regions, decoded ? *decoded : imageGray, windows);
+			threshold.update(detected);
+			if (!cacheKey.empty())
+				cache.store(cacheKey, *regions[idx], detected);
+			return EXIT_SUCCESS;
+		}
+
+		// Process an image that is already in memory, e.g. handed over by a camera driver.
+		// With windows, only those parts of the image are detected (see DetectionROI).
+		T detectFeaturesImage(unsigned int idx, FeatureMap &regions, const GrayImage &imageGray, const std::vector<ImageWindow> &windows = {})
+		{
+			thresholds[idx].update(detect(idx, regions, imageGray, windows));
 			return EXIT_SUCCESS;
 		}
 
@@ -51,18 +103,29 @@ namespace coloc
 
 		}
 #endif
-/*
-		bool saveFeatureData(uint16_t id, FeatureMap &regions, std::string &name)
+
+	private:
+		// Detects into regions[idx] with the drone's current threshold and returns the
+		// keypoint count its threshold controller is updated with
+		size_t detect(unsigned int idx, FeatureMap &regions, const GrayImage &imageGray, const std::vector<ImageWindow> &windows)
 		{
-			const std::string
-				sFeat = stlplus::create_filespec(stlplus::folder_part(name), stlplus::basename_part(name), "feat"),
-				sDesc = stlplus::create_filespec(stlplus::folder_part(name), stlplus::basename_part(name), "desc");
-
-			if (!image_describer->Save(regions.at(id).get(), sFeat, sDesc))
-				return EXIT_FAILURE;
-			else
-				return EXIT_SUCCESS;
+			AKAZEWorkspace& ws = workspace(idx);
+			ws.params.options_.fThreshold = thresholds[idx].value();
+			// Windows that don't fit the image are dropped for a full-frame detection
+			if (windows.empty() || !windowsFit(windows, imageGray.Width(), imageGray.Height())) {
+				regions[idx] = describe_AKAZE(ws, imageGray);
+				return ws.detected;
+			}
+
+			size_t detected = 0;
+			regions[idx] = detectInWindows(imageGray, windows, [&](const GrayImage &crop, const ImageWindow &window) {
+				ws.maxkp = windowBudget(maxkp, window, windows);
+				std::unique_ptr<AKAZE_Binary_Regions> part = describe_AKAZE(ws, crop);
+				detected += ws.detected;
+				return part;
+			});
+			ws.maxkp = maxkp;
+			return fullFrameCount(detected, windows, imageGray.Width(), imageGray.Height());
 		}
-		*/
 	};
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*******************************************************************
+*   CPUDispatch.h
+*   KORAL
+*******************************************************************/
+//
+// Run-time selection of the instruction set used by the KORAL CPU
+// kernels (KFAST, FeatureAngle, LATCH, LERP), so that one binary
+// runs on every host of the fleet and still uses its fastest path.
+//
+// Every vectorized kernel is compiled for its own instruction set
+// with a target attribute, independently of the flags of the rest
+// of the build, and the CPU is queried once at startup. Setting
+// the environment variable COLOC_SIMD to 'scalar', 'sse4.2', 'avx2'
+// or 'avx512' caps the choice, e.g. to compare paths on the same host.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum class KORAL_ISA : int {
+	Scalar = 0,
+	SSE42 = 1,
+	AVX2 = 2,
+	AVX512 = 3		// AVX-512F and BW, on top of AVX2
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KORAL_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define KORAL_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,fma,popcnt,sse4.2")))
+#define KORAL_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,fma,popcnt,sse4.2")))
+#else
+// MSVC emits any intrinsic regardless of /arch
+#define KORAL_TARGET_SSE42
+#define KORAL_TARGET_AVX2
+#define KORAL_TARGET_AVX512
+#endif
+
+inline KORAL_ISA KORAL_detectISA() {
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	// also checks that the OS saves the AVX registers
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx2")
+		&& __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("fma"))
+		return KORAL_ISA::AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("fma"))
+		return KORAL_ISA::AVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return KORAL_ISA::SSE42;
+	return KORAL_ISA::Scalar;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int max_leaf = info[0];
+	__cpuid(info, 1);
+	const bool sse42 = (info[2] >> 20) & 1;
+	const bool fma = (info[2] >> 12) & 1;
+	const bool os_avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+	if (max_leaf >= 7 && fma && os_avx) {
+		__cpuidex(info, 7, 0);
+		// AVX2 and BMI1
+		const bool avx2 = ((info[1] >> 5) & 1) && ((info[1] >> 3) & 1);
+		// AVX-512F, AVX-512BW and BMI2, with the opmask and upper ZMM state saved by the OS
+		if (avx2 && ((info[1] >> 16) & 1) && ((info[1] >> 30) & 1) && ((info[1] >> 8) & 1) && (_xgetbv(0) & 0xE6) == 0xE6)
+			return KORAL_ISA::AVX512;
+		if (avx2)
+			return KORAL_ISA::AVX2;
+	}
+	return sse42 ? KORAL_ISA::SSE42 : KORAL_ISA::Scalar;
+#else
+	return KORAL_ISA::Scalar;
+#endif
+}
+
+inline KORAL_ISA KORAL_capISA(const KORAL_ISA detected) {
+	const char* requested = getenv("COLOC_SIMD");
+	if (requested == nullptr)
+		return detected;
+
+	KORAL_ISA cap = detected;
+	if (strcmp(requested, "scalar") == 0)
+		cap = KORAL_ISA::Scalar;
+	else if (strcmp(requested, "sse4.2") == 0)
+		cap = KORAL_ISA::SSE42;
+	else if (strcmp(requested, "avx2") == 0)
+		cap = KORAL_ISA::AVX2;
+	else if (strcmp(requested, "avx512") == 0)
+		cap = KORAL_ISA::AVX512;
+	return static_cast<int>(cap) < static_cast<int>(detected) ? cap : detected;
+}
+
+// The instruction set the kernels use on this host, decided on first use
+inline KORAL_ISA KORAL_isa() {
+	static const KORAL_ISA isa = KORAL_capISA(KORAL_detectISA());
+	return isa;
+}
+
+inline const char* KORAL_isaName(const KORAL_ISA isa) {
+	switch (isa) {
+	case KORAL_ISA::AVX512: return "AVX-512";
+	case KORAL_ISA::AVX2: return "AVX2";
+	case KORAL_ISA::SSE42: return "SSE4.2";
+	default: return "scalar";
+	}
+}
+
+inline uint32_t KORAL_ctz(const uint32_t m) {
+#ifdef _MSC_VER
+	unsigned long x;
+	_BitScanForward(&x, m);
+	return static_cast<uint32_t>(x);
+#else
+	return static_cast<uint32_t>(__builtin_ctz(m));
+#endif
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#ifdef USE_STREAM
+#include <ros/ros.h>
+#include <image_transport/image_transport.h>
+#include <cv_bridge/cv_bridge.h>
+#endif
+
+#include "openMVG/image/image_io.hpp"
+
+#include "coloc/Keypoint.h"
+#include "coloc/LATCH.h"
+#include "coloc/DetectionROI.hpp"
+#include "coloc/FeatureCache.hpp"
+#include "coloc/ImagePyramid.hpp"
+#include "coloc/KeypointBudget.hpp"
+#include "coloc/ThresholdController.hpp"
+#include "coloc/PyramidDetection.hpp"
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "coloc/colocData.hpp"
+#include "coloc/FeatureDetector.hpp"
+
+using namespace std::chrono;
+
+namespace coloc {
+	// KORAL without a GPU: the scale pyramid is interpolated and the LATCH descriptors are
+	// computed on the CPU, detection and orientation use the same KFAST and FeatureAngle code
+	// as GPUDetector. Produces the same AKAZE_Binary_Regions, so matching is unchanged.
+	template <typename T>
+	class CPUKoralDetector {
+	private:
+		// Pyramid, keypoints and descriptors of one drone's detection, reused by all its frames
+		struct KoralWorkspace {
+			ImagePyramid pyramid;
+			std::vector<Keypoint> kps;
+			std::vector<uint64_t> desc;
+
+			KoralWorkspace(const DetectorOptions& opts) : pyramid(opts.scale_factor, opts.scale_levels, opts.width, opts.height)
+			{
+				kps.reserve(opts.maxkp);
+				desc.reserve(8 * opts.maxkp);
+			}
+		};
+
+		const DetectorOptions opts;
+		const float scale_factor;
+		const uint8_t scale_levels;
+		const unsigned int maxkp;
+		// KFAST threshold of each drone
+		DroneThresholds thresholds;
+		const unsigned int budget_grid;
+		FeatureCache cache;
+
+		// Each drone detects in its own workspace, so drones can be detected concurrently
+		std::map<unsigned int, std::unique_ptr<KoralWorkspace>> workspaces;
+		std::mutex workspacesMutex;
+
+		KoralWorkspace& workspace(unsigned int idx)
+		{
+			std::lock_guard<std::mutex> lock(workspacesMutex);
+			std::unique_ptr<KoralWorkspace>& ws = workspaces[idx];
+			if (!ws)
+				ws.reset(new KoralWorkspace(opts));
+			return *ws;
+		}
+
+	public:
+		CPUKoralDetector(DetectorOptions opts) :
+			opts(opts), scale_factor(opts.scale_factor), scale_levels(opts.scale_levels), maxkp(opts.maxkp), thresholds(opts.thresh, KFAST_minThreshold, KFAST_maxThreshold, opts.target_kp), budget_grid(opts.budget_grid), cache(opts.feature_cache)
+		{
+		}
+
+		// 'decoded', if given, is imageName already read into memory, e.g. by a FramePrefetcher,
+		// and a non-zero 'contentHash' its FeatureCache::contentHash
+		T detectFeaturesFile(unsigned int idx, FeatureMap& regions, std::string& imageName, const std::vector<ImageWindow>& windows = {}, const GrayImage* decoded = nullptr, uint64_t contentHash = 0)
+		{
+			// An image detected before with the same settings is read back from the cache
+			std::string cacheKey;
+			if (cache.enabled()) {
+				ThresholdController& threshold = thresholds[idx];
+				std::ostringstream config;
+				config << "KORAL " << scale_factor << ' ' << static_cast<int>(scale_levels) << ' ' << maxkp << ' ' << budget_grid;
+				const std::string configuration = FeatureCache::configuration(config.str(), static_cast<float>(std::lround(threshold.value())), windows);
+				cacheKey = contentHash ? cache.key(contentHash, configuration) : cache.key(imageName, configuration);
+				uint64_t detected;
+				if (!cacheKey.empty() && cache.load(cacheKey, regions[idx], detected)) {
+					threshold.update(detected);
+					return EXIT_SUCCESS;
+				}
+			}
+
+			GrayImage image;
+			if (!decoded && !ReadImage(imageName.c_str(), &image)) {
+				std::cout << "Unable to read image from the given path." << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			high_resolution_clock::time_point t1 = high_resolution_clock::now();
+			const size_t detected = detect(idx, regions, decoded ? *decoded : image, windows);
+			thresholds[idx].update(detected);
+			high_resolution_clock::time_point t2 = high_resolution_clock::now();
+			std::cout << "Detected " << regions[idx]->Features().size() << " features in " << duration_cast<milliseconds>(t2 - t1).count() << " ms \n" << std::endl;
+
+			if (!cacheKey.empty())
+				cache.store(cacheKey, *regions[idx], detected);
+			return EXIT_SUCCESS;
+		}
+
+		// Process an image that is already in memory, e.g. handed over by a camera driver.
+		// With windows, only those parts of the image are detected (see DetectionROI).
+		T detectFeaturesImage(unsigned int idx, FeatureMap& regions, const GrayImage& image, const std::vector<ImageWindow>& windows = {})
+		{
+			thresholds[idx].update(detect(idx, regions, image, windows));
+			return EXIT_SUCCESS;
+		}
+
+#ifdef USE_STREAM
+		void detectFeaturesTopic(uint8_t idx, FeatureMap& regions, cv_bridge::CvImagePtr imagePtr)
+		{
+			ThresholdController& threshold = thresholds[idx];
+			KoralWorkspace& ws = workspace(idx);
+			high_resolution_clock::time_point t1 = high_resolution_clock::now();
+			threshold.update(detectAndDescribe(ws, imagePtr->image.data, imagePtr->image.cols, imagePtr->image.rows, static_cast<uint8_t>(std::lround(threshold.value())), maxkp));
+			high_resolution_clock::time_point t2 = high_resolution_clock::now();
+			ROS_INFO("Detected %d features in %ld ms \n", ws.kps.size(), duration_cast<milliseconds>(t2 - t1).count());
+
+			regions[idx] = makeRegions(ws);
+		}
+#endif
+
+	private:
+		// Detects into regions[idx] with the drone's current threshold and returns the
+		// keypoint count its threshold controller is updated with
+		size_t detect(unsigned int idx, FeatureMap& regions, const GrayImage& image, const std::vector<ImageWindow>& windows)
+		{
+			const uint8_t KFAST_thresh = static_cast<uint8_t>(std::lround(thresholds[idx].value()));
+			KoralWorkspace& ws = workspace(idx);
+			// Windows that don't fit the image are dropped for a full-frame detection
+			if (windows.empty() || !windowsFit(windows, image.Width(), image.Height())) {
+				const size_t detected = detectAndDescribe(ws, image.data(), image.Width(), image.Height(), KFAST_thresh, maxkp);
+				regions[idx] = makeRegions(ws);
+				return detected;
+			}
+
+			size_t detected = 0;
+			regions[idx] = detectInWindows(image, windows, [&](const GrayImage& crop, const ImageWindow& window) {
+				detected += detectAndDescribe(ws, crop.data(), crop.Width(), crop.Height(), KFAST_thresh, windowBudget(maxkp, window, windows));
+				return makeRegions(ws);
+			});
+			return fullFrameCount(detected, windows, image.Width(), image.Height());
+		}
+
+		// Converts the last detection in ws into regions
+		std::unique_ptr<AKAZE_Binary_Regions> makeRegions(const KoralWorkspace& ws) const
+		{
+			const std::vector<Keypoint>& kps = ws.kps;
+			const std::vector<uint64_t>& desc = ws.desc;
+			std::unique_ptr<AKAZE_Binary_Regions> regions(new AKAZE_Binary_Regions);
+
+			regions->Features().resize(kps.size());
+			regions->Descriptors().resize(kps.size());
+
+			for (size_t i = 0; i < kps.size(); ++i) {
+				const float scale = std::pow(scale_factor, kps[i].scale);
+				regions->Features()[i] = {
+						scale * static_cast <float> (kps[i].x),
+						scale * static_cast <float> (kps[i].y),
+						7.0f * scale,
+						kps[i].angle
+				};
+
+				std::memcpy(&(regions->Descriptors()[i]), &(desc[i * 8]), 8 * sizeof(uint64_t));
+			}
+			return regions;
+		}
+
+		// Detects with KFAST threshold KFAST_thresh, keeps at most 'budget' keypoints and describes them.
+		// Returns the number of keypoints found before the budget, for the threshold controller.
+		size_t detectAndDescribe(KoralWorkspace& ws, const uint8_t* image, const uint32_t width, const uint32_t height, const uint8_t KFAST_thresh, const size_t budget)
+		{
+			ImagePyramid& pyramid = ws.pyramid;
+			std::vector<Keypoint>& kps = ws.kps;
+			std::vector<uint64_t>& desc = ws.desc;
+			pyramid.build(image, width, height);
+			const uint8_t* const* levelImages = pyramid.levelImages();
+			const uint32_t* levelWidths = pyramid.levelWidths();
+			const uint32_t* levelHeights = pyramid.levelHeights();
+
+			detectPyramid(levelImages, levelWidths, levelHeights, scale_levels, KFAST_thresh, kps);
+			const size_t detected = kps.size();
+			applyKeypointBudget(kps, budget, static_cast<float>(width), static_cast<float>(height), budget_grid, [this](const Keypoint& kp) {
+				const float scale = std::pow(scale_factor, kp.scale);
+				return BudgetPoint{ scale * kp.x, scale * kp.y, static_cast<float>(kp.score) };
+			});
+
+			// Compute LATCH descriptors for all the keypoints
+			desc.resize(8 * kps.size());
+			LATCH(levelImages, levelWidths, levelHeights, kps.data(), static_cast<int>(kps.size()), desc.data());
+			return detected;
+		}
+	};
+}
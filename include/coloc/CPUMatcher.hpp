@@ -11,6 +11,7 @@
 #include "coloc/colocData.hpp"
 #include "coloc/FeatureMatcher.hpp"
 #include "coloc/colocUtils.hpp"
+#include "coloc/ThreadPool.hpp"
 
 using namespace openMVG;
 using namespace openMVG::matching;
@@ -37,14 +38,20 @@ namespace coloc
 
 		T computeMatches(FeatureMap& regions, PairWiseMatches &putativeMatches)
 		{
-			Pair_Set pairs = Utils::handlePairs(static_cast<int> (regions.size()));
-
-			IndMatches pairMatches;
-			for (const auto pairIdx : pairs) {
-				computeMatchesPair(pairIdx, regions, pairMatches);
-				if (!pairMatches.empty()) {
-					putativeMatches.insert({ pairIdx, std::move(pairMatches) });
-					overlap.insert({ pairIdx, std::move(pairMatches.size()) });
+			Pair_Set pairSet = Utils::handlePairs(static_cast<int> (regions.size()));
+			std::vector <Pair> pairs(pairSet.begin(), pairSet.end());
+
+			// Pairs are matched as pool tasks, results are merged in pair order afterwards
+			std::vector <IndMatches> pairMatches(pairs.size());
+			ThreadPool::instance().parallelFor(0, pairs.size(), [&](size_t i) {
+				computeMatchesPair(pairs[i], regions, pairMatches[i]);
+			});
+
+			for (size_t i = 0; i < pairs.size(); ++i) {
+				const Pair& pairIdx = pairs[i];
+				if (!pairMatches[i].empty()) {
+					overlap.insert({ pairIdx, static_cast<unsigned int>(pairMatches[i].size()) });
+					putativeMatches.insert({ pairIdx, std::move(pairMatches[i]) });
 				}
 				else {
 					overlap.insert({ pairIdx, 0 });
@@ -53,7 +60,7 @@ namespace coloc
 			return EXIT_SUCCESS;
 		}
 
-		bool matchMapFeatures(std::unique_ptr<features::AKAZE_Binary_Regions> &scene1, std::unique_ptr<features::AKAZE_Binary_Regions> &scene2, std::vector<IndMatch> &commonFeatures)
+		bool matchMapFeatures(const std::unique_ptr<features::AKAZE_Binary_Regions> &scene1, const std::unique_ptr<features::AKAZE_Binary_Regions> &scene2, std::vector<IndMatch> &commonFeatures)
 		{
 			matching::DistanceRatioMatch(
 				0.8, BRUTE_FORCE_HAMMING,
@@ -77,7 +84,14 @@ namespace coloc
 
 		bool matchSceneWithMap(unsigned int idx, colocData &data, IndMatches &trackedFeatures)
 		{
-			if (&data.scene == nullptr) {
+			return matchRegionsWithMap(data, *data.regions.at(idx), trackedFeatures);
+		}
+
+		// Matches a query image against the map without touching data.regions, so that
+		// several drones can be tracked against the same (read-only) map at once.
+		bool matchRegionsWithMap(const colocData &data, const features::Regions &queryRegions, IndMatches &trackedFeatures)
+		{
+			if (!data.mapRegions) {
 				std::cout << "No existing map. Localization cannot continue." << std::endl;
 				return EXIT_FAILURE;
 			}
@@ -85,7 +99,7 @@ namespace coloc
 			matching::DistanceRatioMatch(
 				0.8, this->matchingType,
 				*data.mapRegions.get(),
-				*data.regions.at(idx),
+				queryRegions,
 				trackedFeatures);
 
 			if (trackedFeatures.empty()) {
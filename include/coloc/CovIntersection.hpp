@@ -21,19 +21,21 @@ public:
 		cb = posB;
 	}
 
-	static double function(double x)
+	// Covariance intersection cost for weight x; evaluated on this instance's data so that
+	// independent sessions can fuse concurrently
+	double function(double x) const
 	{
 		// double value = sum(diag(inv(inv(CA) + inv(CB) - inv(x*CA + (1-x)*CB))));
 		return sum(diag(inv(inv(CA) + inv(CB) - inv(x*CA + (1 - x)*CB))));
 		// return value;
 	}
 
-	static matrix<double, DIM, DIM> CA, CB;
-	static matrix<double, DIM, 1> ca, cb;
+	matrix<double, DIM, DIM> CA, CB;
+	matrix<double, DIM, 1> ca, cb;
 
 	void optimize()
 	{
-		minValue = find_min_single_variable(&CovIntersection::function, starting_point, begin, end, eps, max_iter, initial_search_radius);
+		minValue = find_min_single_variable([this](double x) { return function(x); }, starting_point, begin, end, eps, max_iter, initial_search_radius);
 		minX = starting_point;
 	}
 
@@ -63,8 +65,3 @@ private:
 	const double initial_search_radius = 0.01;
 	// print variables
 };
-
-matrix <double, DIM, DIM> CovIntersection::CA;
-matrix <double, DIM, DIM> CovIntersection::CB;
-matrix <double, DIM, 1> CovIntersection::ca;
-matrix <double, DIM, 1> CovIntersection::cb;
\ No newline at end of file
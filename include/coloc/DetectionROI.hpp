@@ -0,0 +1,207 @@
+#pragma once
+
+#include "coloc/colocData.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace coloc
+{
+	// Part of an image, in pixels
+	struct ImageWindow {
+		int x;
+		int y;
+		int width;
+		int height;
+
+		double area() const { return static_cast<double>(width) * height; }
+
+		bool contains(float u, float v) const
+		{
+			return u >= x && v >= y && u < x + width && v < y + height;
+		}
+	};
+
+	// Windows are detected with this many extra pixels around them, so that features on their
+	// edges are still found and described; only the features inside the window proper are kept
+	constexpr int ROIWindowBorder = 48;
+
+	// Image windows in which the map's landmark volumes reproject for a camera with intrinsics K
+	// at 'pose', each volume grown by 'margin' pixels. The image is divided into grid x grid tiles
+	// and there is one window per run of tile rows that cover the same columns, so the windows
+	// never overlap. An empty result means the whole frame: nothing of the map is in view, a
+	// volume reaches behind the camera, or the windows would cover more than maxCoverage of the image.
+	inline std::vector<ImageWindow> predictWindows(const std::vector<LandmarkVolume>& volumes, const Pose3& pose, const Mat3& K,
+		int width, int height, int margin, unsigned int grid = 8, double maxCoverage = 0.7)
+	{
+		std::vector<ImageWindow> windows;
+		const int tiles = static_cast<int>(std::max(grid, 1u));
+		std::vector<char> covered(tiles * tiles, 0);
+		bool inView = false;
+
+		for (const LandmarkVolume& volume : volumes) {
+			int front = 0;
+			double u0 = std::numeric_limits<double>::max(), v0 = u0, u1 = -u0, v1 = -u0;
+			for (int corner = 0; corner < 8; ++corner) {
+				const Vec3 X((corner & 1) ? volume.max[0] : volume.min[0],
+					(corner & 2) ? volume.max[1] : volume.min[1],
+					(corner & 4) ? volume.max[2] : volume.min[2]);
+				const Vec3 p = K * pose(X);
+				if (p[2] <= 1e-6)
+					continue;
+				++front;
+				u0 = std::min(u0, p[0] / p[2]);
+				u1 = std::max(u1, p[0] / p[2]);
+				v0 = std::min(v0, p[1] / p[2]);
+				v1 = std::max(v1, p[1] / p[2]);
+			}
+			if (front == 0)
+				continue;
+			// Its projection is unbounded
+			if (front < 8)
+				return std::vector<ImageWindow>();
+
+			u0 = std::max(u0 - margin, 0.0);
+			v0 = std::max(v0 - margin, 0.0);
+			u1 = std::min(u1 + margin, static_cast<double>(width));
+			v1 = std::min(v1 + margin, static_cast<double>(height));
+			if (u0 >= u1 || v0 >= v1)
+				continue;
+			inView = true;
+
+			const int tx0 = static_cast<int>(u0 * tiles / width), tx1 = std::min(static_cast<int>(u1 * tiles / width), tiles - 1);
+			const int ty0 = static_cast<int>(v0 * tiles / height), ty1 = std::min(static_cast<int>(v1 * tiles / height), tiles - 1);
+			for (int ty = ty0; ty <= ty1; ++ty)
+				std::fill(covered.begin() + ty * tiles + tx0, covered.begin() + ty * tiles + tx1 + 1, 1);
+		}
+		if (!inView)
+			return windows;
+
+		double area = 0.0;
+		int previousFirst = -1, previousLast = -1;
+		for (int ty = 0; ty < tiles; ++ty) {
+			const auto row = covered.begin() + ty * tiles;
+			const int first = static_cast<int>(std::find(row, row + tiles, 1) - row);
+			if (first == tiles) {
+				previousFirst = -1;
+				continue;
+			}
+			int last = tiles - 1;
+			while (!row[last])
+				--last;
+
+			const int x0 = first * width / tiles, x1 = (last + 1) * width / tiles;
+			const int y0 = ty * height / tiles, y1 = (ty + 1) * height / tiles;
+			if (first == previousFirst && last == previousLast)
+				windows.back().height = y1 - windows.back().y;
+			else
+				windows.push_back(ImageWindow{ x0, y0, x1 - x0, y1 - y0 });
+			area += static_cast<double>(x1 - x0) * (y1 - y0);
+			previousFirst = first;
+			previousLast = last;
+		}
+
+		if (area > maxCoverage * width * height)
+			windows.clear();
+		return windows;
+	}
+
+	inline double windowsArea(const std::vector<ImageWindow>& windows)
+	{
+		double area = 0.0;
+		for (const ImageWindow& window : windows)
+			area += window.area();
+		return area;
+	}
+
+	// The share of a keypoint budget (0: no budget) that one of the windows is worth
+	inline size_t windowBudget(size_t budget, const ImageWindow& window, const std::vector<ImageWindow>& windows)
+	{
+		return static_cast<size_t>(std::ceil(budget * window.area() / windowsArea(windows)));
+	}
+
+	// Keypoints a full width x height frame would have at the density found in the windows
+	inline size_t fullFrameCount(size_t count, const std::vector<ImageWindow>& windows, int width, int height)
+	{
+		return static_cast<size_t>(count * (static_cast<double>(width) * height) / std::max(windowsArea(windows), 1.0));
+	}
+
+	// Whether all the windows lie inside a width x height image. They don't if the image is not the
+	// size they were predicted for, e.g. when it could not be read and is empty.
+	inline bool windowsFit(const std::vector<ImageWindow>& windows, int width, int height)
+	{
+		for (const ImageWindow& window : windows) {
+			if (window.width <= 0 || window.height <= 0 || window.x < 0 || window.y < 0
+				|| window.x + window.width > width || window.y + window.height > height)
+				return false;
+		}
+		return true;
+	}
+
+	// Copies 'window' of 'image' into 'crop'
+	inline void cropImage(const GrayImage& image, const ImageWindow& window, GrayImage& crop)
+	{
+		crop.resize(window.width, window.height);
+		for (int row = 0; row < window.height; ++row)
+			std::memcpy(crop.data() + static_cast<size_t>(row) * window.width,
+				image.data() + static_cast<size_t>(window.y + row) * image.Width() + window.x, window.width);
+	}
+
+	// Runs detect(crop, window) on every window, padded by ROIWindowBorder, and gathers the
+	// features that lie inside the windows, in image coordinates, into one set of regions.
+	// Windows that don't overlap the image are skipped.
+	template <typename F>
+	std::unique_ptr<AKAZE_Binary_Regions> detectInWindows(const GrayImage& image, const std::vector<ImageWindow>& windows, F detect)
+	{
+		std::unique_ptr<AKAZE_Binary_Regions> regions(new AKAZE_Binary_Regions);
+		GrayImage crop;
+		for (const ImageWindow& window : windows) {
+			const int x0 = std::max(window.x - ROIWindowBorder, 0), y0 = std::max(window.y - ROIWindowBorder, 0);
+			const int x1 = std::min(window.x + window.width + ROIWindowBorder, image.Width());
+			const int y1 = std::min(window.y + window.height + ROIWindowBorder, image.Height());
+			if (x1 <= x0 || y1 <= y0)
+				continue;
+			const ImageWindow padded{ x0, y0, x1 - x0, y1 - y0 };
+			cropImage(image, padded, crop);
+
+			std::unique_ptr<AKAZE_Binary_Regions> part = detect(crop, window);
+			for (size_t i = 0; i < part->Features().size(); ++i) {
+				SIOPointFeature feature = part->Features()[i];
+				feature.x() += padded.x;
+				feature.y() += padded.y;
+				if (!window.contains(feature.x(), feature.y()))
+					continue;
+				regions->Features().push_back(feature);
+				regions->Descriptors().push_back(part->Descriptors()[i]);
+			}
+		}
+		return regions;
+	}
+
+	// Windows each drone's next frame is detected in, empty for the whole frame
+	class DetectionWindows
+	{
+	public:
+		void set(unsigned int droneId, std::vector<ImageWindow> windows)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			droneWindows[droneId] = std::move(windows);
+		}
+
+		std::vector<ImageWindow> get(unsigned int droneId)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = droneWindows.find(droneId);
+			return it == droneWindows.end() ? std::vector<ImageWindow>() : it->second;
+		}
+
+	private:
+		std::map<unsigned int, std::vector<ImageWindow>> droneWindows;
+		std::mutex mutex;
+	};
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "coloc/coloc.hpp"
+#include "coloc/BoundedQueue.hpp"
+#include "coloc/ThreadPool.hpp"
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+
+namespace coloc
+{
+	enum class FrameStatus {
+		Localized,			// pose estimated from the map
+		Lost,				// localization failed, pose is the filter's prediction
+		MapCreated,			// frame was used to build the initial map
+		MapInitializing,	// waiting for a first frame from every drone before building the map
+		Rejected			// not processed: invalid drone, superseded while waiting, or engine stopped
+	};
+
+	struct FrameResult {
+		int droneId;
+		double timestamp;
+		Pose3 pose;
+		Cov6 cov{};
+		int nTracks = 0;
+		FrameStatus status = FrameStatus::Rejected;
+	};
+
+	// Library front end of ColoC. Frames are pushed from memory, e.g. straight from camera
+	// drivers, and each submission is answered through a future or a callback.
+	//
+	// Submissions are queued and handled by a dispatcher thread in batches of at most one
+	// frame per drone: the batch is detected and tracked in parallel, then published and
+	// followed by the inter-MAV step. The initial map is built from the first frame of
+	// every drone; until then only the newest frame of each drone is kept.
+	class Engine
+	{
+	public:
+		typedef std::function<void(const FrameResult&)> Callback;
+
+		Engine(unsigned int numDrones, colocParams& params, DetectorOptions& dOpts, MatcherOptions& mOpts, size_t queueSize = 64)
+			: nDrones(numDrones), detector(dOpts), tracker(nDrones, startNumber, params, dOpts, mOpts), submissions(queueSize), waiting(numDrones)
+		{
+			dispatcher = std::thread([this]() { run(); });
+		}
+
+		~Engine()
+		{
+			stop();
+		}
+
+		// Blocks while the queue is full
+		std::future<FrameResult> submitFrame(int droneId, double timestamp, GrayImage image)
+		{
+			Submission submission(droneId, timestamp, std::move(image));
+			submission.promise = std::make_shared<std::promise<FrameResult>>();
+			std::future<FrameResult> result = submission.promise->get_future();
+			enqueue(std::move(submission));
+			return result;
+		}
+
+		// The callback runs on the engine's dispatcher thread
+		void submitFrame(int droneId, double timestamp, GrayImage image, Callback callback)
+		{
+			Submission submission(droneId, timestamp, std::move(image));
+			submission.callback = callback;
+			enqueue(std::move(submission));
+		}
+
+		// Finishes the frames already submitted and the background inter-MAV work
+		void stop()
+		{
+			submissions.close();
+			if (dispatcher.joinable()) {
+				dispatcher.join();
+				tracker.shutdown();
+			}
+		}
+
+	private:
+		struct Submission {
+			int droneId = -1;
+			double timestamp = 0.0;
+			GrayImage image;
+			std::shared_ptr<std::promise<FrameResult>> promise;
+			Callback callback;
+
+			Submission() {}
+			Submission(int _droneId, double _timestamp, GrayImage _image) : droneId(_droneId), timestamp(_timestamp), image(std::move(_image)) {}
+		};
+
+		unsigned int nDrones;
+		int startNumber = 0;
+		unsigned int frameNumber = 0;
+#ifdef USE_CUDA
+		FeatureDetector <bool, GPUDetector> detector;
+#elif defined(USE_KORAL_CPU)
+		FeatureDetector <bool, CPUKoralDetector> detector;
+#else
+		FeatureDetector <bool, CPUDetector> detector;
+#endif
+		ColoC tracker;
+		BoundedQueue <Submission> submissions;
+		std::vector <std::deque<Submission>> waiting;
+		std::thread dispatcher;
+
+		void enqueue(Submission submission)
+		{
+			if (submission.droneId < 0 || submission.droneId >= static_cast<int>(nDrones)) {
+				std::cout << "Rejecting frame of unknown drone " << submission.droneId << std::endl;
+				deliver(submission, FrameStatus::Rejected);
+				return;
+			}
+			Submission receipt(submission.droneId, submission.timestamp, GrayImage());
+			receipt.promise = submission.promise;
+			receipt.callback = submission.callback;
+			if (!submissions.push(std::move(submission)))
+				deliver(receipt, FrameStatus::Rejected);
+		}
+
+		void run()
+		{
+			Submission submission;
+			while (submissions.pop(submission)) {
+				// Take everything that queued up meanwhile, then work through it batch by batch
+				do {
+					wait(std::move(submission));
+				} while (submissions.tryPop(submission));
+
+				while (processBatch());
+			}
+
+			// Frames still waiting for the map when the engine stopped
+			for (auto& frames : waiting) {
+				for (auto& frame : frames)
+					deliver(frame, FrameStatus::Rejected);
+				frames.clear();
+			}
+		}
+
+		void wait(Submission submission)
+		{
+			std::deque<Submission>& frames = waiting[submission.droneId];
+			// Only one frame per drone is needed to build the map; older ones are superseded
+			if (!tracker.isMapReady() && !frames.empty()) {
+				deliver(frames.front(), FrameStatus::Rejected);
+				frames.pop_front();
+			}
+			frames.push_back(std::move(submission));
+		}
+
+		// Processes the oldest waiting frame of every drone; false if there was nothing to do
+		bool processBatch()
+		{
+			std::vector <Submission> batch;
+			std::vector <int> droneIds;
+			for (unsigned int id = 0; id < nDrones; ++id) {
+				if (waiting[id].empty())
+					continue;
+				batch.push_back(std::move(waiting[id].front()));
+				waiting[id].pop_front();
+				droneIds.push_back(id);
+			}
+
+			if (!tracker.isMapReady() && batch.size() < nDrones) {
+				// Put the frames back until every drone has one
+				for (auto& frame : batch)
+					waiting[frame.droneId].push_front(std::move(frame));
+				return false;
+			}
+			if (batch.empty())
+				return false;
+
+			tracker.setFrameNumber(frameNumber);
+			std::vector <FeatureMap> regions(batch.size());
+			forEach(batch.size(), [&](size_t i) {
+				detector.detectFeaturesImage(batch[i].droneId, regions[i], batch[i].image, tracker.detectionWindows(batch[i].droneId));
+			});
+
+			if (!tracker.isMapReady()) {
+				for (size_t i = 0; i < batch.size(); ++i)
+					tracker.setFrame(batch[i].droneId, std::move(regions[i].at(batch[i].droneId)), frameName(batch[i]));
+
+				std::vector <Pose3> poses;
+				const bool created = tracker.createMap(droneIds, poses) == EXIT_SUCCESS;
+				for (size_t i = 0; i < batch.size(); ++i) {
+					FrameResult result = makeResult(batch[i], created ? FrameStatus::MapCreated : FrameStatus::MapInitializing);
+					result.pose = poses[i];
+					deliver(batch[i], result);
+				}
+			}
+			else {
+				std::vector <FrameResult> results(batch.size());
+				forEach(batch.size(), [&](size_t i) {
+					FrameResult& result = results[i];
+					result = makeResult(batch[i], FrameStatus::Lost);
+					const bool status = tracker.trackFrame(batch[i].droneId, *regions[i].at(batch[i].droneId), result.pose, result.cov, result.nTracks);
+					if (status == EXIT_SUCCESS)
+						result.status = FrameStatus::Localized;
+				});
+
+				// Publish the frames for inter-MAV estimation only after all drones were tracked
+				for (size_t i = 0; i < batch.size(); ++i) {
+					tracker.setFrame(batch[i].droneId, std::move(regions[i].at(batch[i].droneId)), frameName(batch[i]));
+					deliver(batch[i], results[i]);
+				}
+				tracker.interStep();
+			}
+
+			frameNumber++;
+			return true;
+		}
+
+		template <typename F>
+		void forEach(size_t n, F f)
+		{
+#ifdef USE_CUDA
+			// The GPU detector and matcher share device buffers between calls
+			for (size_t i = 0; i < n; ++i)
+				f(i);
+#else
+			ThreadPool::instance().parallelFor(0, n, f);
+#endif
+		}
+
+		static std::string frameName(const Submission& submission)
+		{
+			return "drone" + std::to_string(submission.droneId) + "_" + std::to_string(submission.timestamp);
+		}
+
+		static FrameResult makeResult(const Submission& submission, FrameStatus status)
+		{
+			FrameResult result;
+			result.droneId = submission.droneId;
+			result.timestamp = submission.timestamp;
+			result.status = status;
+			return result;
+		}
+
+		static void deliver(Submission& submission, FrameStatus status)
+		{
+			FrameResult result = makeResult(submission, status);
+			deliver(submission, result);
+		}
+
+		static void deliver(Submission& submission, const FrameResult& result)
+		{
+			if (submission.promise)
+				submission.promise->set_value(result);
+			if (submission.callback)
+				submission.callback(result);
+		}
+	};
+}
@@ -155,6 +155,8 @@
 #include <cstdint>
 #include <immintrin.h>
 
+#include "CPUDispatch.h"
+
 constexpr float PI = 3.1415927f;
 
 float fastAtan2(float y, float x) {
@@ -194,7 +196,38 @@ static const __m128i ywt0 = _mm_setr_epi16(0, 0, 3, 3, 3, 0, 0, 0);
 static const __m128i ywt1 = _mm_setr_epi16(0, 2, 2, 2, 2, 2, 0, 0);
 static const __m128i ywt2 = _mm_setr_epi16(1, 1, 1, 1, 1, 1, 1, 0);
 
-float featureAngle(const uint8_t* const __restrict image, const int px, const int py, const int step) {
+inline void featureAngleSums_scalar(const uint8_t* const __restrict image, const int px, const int py, const int step, float& x_sum, float& y_sum) {
+	static const int8_t xwt[7][7] = {
+		{ 0, 0, -1, 0, 1, 0, 0 },
+		{ 0, -2, -1, 0, 1, 2, 0 },
+		{ -3, -2, -1, 0, 1, 2, 3 },
+		{ -3, -2, -1, 0, 1, 2, 3 },
+		{ -3, -2, -1, 0, 1, 2, 3 },
+		{ 0, -2, -1, 0, 1, 2, 0 },
+		{ 0, 0, -1, 0, 1, 0, 0 } };
+	static const int8_t ywt[7][7] = {
+		{ 0, 0, -3, -3, -3, 0, 0 },
+		{ 0, -2, -2, -2, -2, -2, 0 },
+		{ -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 0, 0, 0, 0, 0, 0 },
+		{ 1, 1, 1, 1, 1, 1, 1 },
+		{ 0, 2, 2, 2, 2, 2, 0 },
+		{ 0, 0, 3, 3, 3, 0, 0 } };
+
+	const uint8_t* __restrict p = image + (py - 3)*step + (px - 3);
+	int x = 0, y = 0;
+	for (int i = 0; i < 7; ++i, p += step) {
+		for (int j = 0; j < 7; ++j) {
+			x += xwt[i][j] * p[j];
+			y += ywt[i][j] * p[j];
+		}
+	}
+	x_sum = static_cast<float>(x);
+	y_sum = static_cast<float>(y);
+}
+
+KORAL_TARGET_SSE42
+inline void featureAngleSums_SSE(const uint8_t* const __restrict image, const int px, const int py, const int step, float& x_sum, float& y_sum) {
 	const uint8_t* __restrict p = image + (py - 3)*step + (px - 3);
 	__m128i x = _mm_setzero_si128();
 	__m128i y = _mm_setzero_si128();
@@ -236,12 +269,67 @@ float featureAngle(const uint8_t* const __restrict image, const int px, const in
 	x = _mm_add_epi16(x, _mm_shuffle_epi32(x, 78));
 	x = _mm_hadd_epi16(x, x);
 	x = _mm_add_epi16(x, _mm_shufflelo_epi16(x, 225));
-	const float x_sum = static_cast<float>(static_cast<int16_t>(_mm_cvtsi128_si32(x)));
+	x_sum = static_cast<float>(static_cast<int16_t>(_mm_cvtsi128_si32(x)));
 
 	y = _mm_add_epi16(y, _mm_shuffle_epi32(y, 78));
 	y = _mm_hadd_epi16(y, y);
 	y = _mm_add_epi16(y, _mm_shufflelo_epi16(y, 225));
-	const float y_sum = static_cast<float>(static_cast<int16_t>(_mm_cvtsi128_si32(y)));
+	y_sum = static_cast<float>(static_cast<int16_t>(_mm_cvtsi128_si32(y)));
+}
 
+// Rows i and 6 - i of the window, widened to 16 bits
+KORAL_TARGET_AVX2
+inline __m256i featureAngle_rows(const uint8_t* const __restrict p, const int step, const int i) {
+	return _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + i*step)),
+		_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + (6 - i)*step))));
+}
+
+// Rows 0 and 6, 1 and 5, 2 and 4 share their x weights and have opposite y weights,
+// so each pair is weighted in one 256-bit vector
+KORAL_TARGET_AVX2
+inline void featureAngleSums_AVX2(const uint8_t* const __restrict image, const int px, const int py, const int step, float& x_sum, float& y_sum) {
+	const uint8_t* __restrict p = image + (py - 3)*step + (px - 3);
+	const __m256i xw0 = _mm256_broadcastsi128_si256(xwt0);
+	const __m256i xw1 = _mm256_broadcastsi128_si256(xwt1);
+	const __m256i xw2 = _mm256_broadcastsi128_si256(xwt2);
+	const __m256i yw0 = _mm256_setr_epi16(0, 0, -3, -3, -3, 0, 0, 0, 0, 0, 3, 3, 3, 0, 0, 0);
+	const __m256i yw1 = _mm256_setr_epi16(0, -2, -2, -2, -2, -2, 0, 0, 0, 2, 2, 2, 2, 2, 0, 0);
+	const __m256i yw2 = _mm256_setr_epi16(-1, -1, -1, -1, -1, -1, -1, 0, 1, 1, 1, 1, 1, 1, 1, 0);
+
+	__m256i r = featureAngle_rows(p, step, 0);
+	__m256i x = _mm256_mullo_epi16(r, xw0);
+	__m256i y = _mm256_mullo_epi16(r, yw0);
+
+	r = featureAngle_rows(p, step, 1);
+	x = _mm256_add_epi16(x, _mm256_mullo_epi16(r, xw1));
+	y = _mm256_add_epi16(y, _mm256_mullo_epi16(r, yw1));
+
+	r = featureAngle_rows(p, step, 2);
+	x = _mm256_add_epi16(x, _mm256_mullo_epi16(r, xw2));
+	y = _mm256_add_epi16(y, _mm256_mullo_epi16(r, yw2));
+
+	// row 3 only has x weights
+	__m128i xs = _mm_add_epi16(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+	xs = _mm_add_epi16(xs, _mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 3*step))), xwt2));
+	const __m128i ys = _mm_add_epi16(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+
+	// x sum in word 0, y sum in word 1
+	__m128i xy = _mm_hadd_epi16(xs, ys);
+	xy = _mm_hadd_epi16(xy, xy);
+	xy = _mm_hadd_epi16(xy, xy);
+	x_sum = static_cast<float>(static_cast<int16_t>(_mm_extract_epi16(xy, 0)));
+	y_sum = static_cast<float>(static_cast<int16_t>(_mm_extract_epi16(xy, 1)));
+}
+
+// The weighted sums are computed with the fastest instruction set of the host, the
+// arctangent outside of the vector code so that every path returns the same angle
+inline float featureAngle(const uint8_t* const __restrict image, const int px, const int py, const int step) {
+	float x_sum, y_sum;
+	switch (KORAL_isa()) {
+	case KORAL_ISA::AVX512:
+	case KORAL_ISA::AVX2: featureAngleSums_AVX2(image, px, py, step, x_sum, y_sum); break;
+	case KORAL_ISA::SSE42: featureAngleSums_SSE(image, px, py, step, x_sum, y_sum); break;
+	default: featureAngleSums_scalar(image, px, py, step, x_sum, y_sum);
+	}
 	return fastAtan2(y_sum, x_sum);
-}
\ No newline at end of file
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "coloc/colocData.hpp"
+#include "coloc/DetectionROI.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace coloc
+{
+	// On-disk cache of detected features, so that replaying a dataset does not detect every image
+	// again. An entry is keyed by a hash of the image file's bytes and of the detector configuration
+	// that produced it, including the threshold a ThresholdController had reached and the detection
+	// windows, so a replay hits exactly the frames it would have detected the same way.
+	//
+	// An entry is one file: a header, the features as four floats each (x, y, scale, orientation),
+	// then the 64-byte descriptors. It is memory-mapped to be read, and written to a temporary
+	// file that is renamed into place, so concurrent detectors never see a partial entry.
+	class FeatureCache
+	{
+	public:
+		// Bump when detection changes in a way the configuration does not capture
+		static constexpr uint32_t version = 1;
+
+		// An empty directory disables the cache
+		explicit FeatureCache(const std::string& directory) : directory(directory)
+		{
+			if (!directory.empty() && !stlplus::folder_exists(directory) && !stlplus::folder_create(directory)) {
+				std::cout << "Unable to create the feature cache in " << directory << ", caching disabled" << std::endl;
+				this->directory.clear();
+			}
+		}
+
+		bool enabled() const { return !directory.empty(); }
+
+		// Hash of the bytes of the file 'imageName', the part of a key that names the image.
+		// Reads the whole file, so callers off the critical path (e.g. a FramePrefetcher) compute it ahead.
+		static bool contentHash(const std::string& imageName, uint64_t& content)
+		{
+			std::ifstream file(imageName, std::ios::binary | std::ios::ate);
+			if (!file)
+				return false;
+			std::string bytes(static_cast<size_t>(file.tellg()), '\0');
+			file.seekg(0);
+			if (!file.read(&bytes[0], bytes.size()))
+				return false;
+			content = hash(bytes.data(), bytes.size());
+			return true;
+		}
+
+		// Name of the entry for the file 'imageName' detected with 'configuration', empty if the file can't be read
+		std::string key(const std::string& imageName, const std::string& configuration) const
+		{
+			uint64_t content;
+			if (!contentHash(imageName, content))
+				return std::string();
+			return key(content, configuration);
+		}
+
+		// Name of the entry for an image whose contentHash is already known
+		std::string key(uint64_t content, const std::string& configuration) const
+		{
+			std::ostringstream name;
+			name << std::hex << std::setfill('0') << std::setw(16) << content
+				<< '-' << std::setw(16) << hash(configuration.data(), configuration.size());
+			return stlplus::create_filespec(directory, name.str(), "feat");
+		}
+
+		// Detector configuration of a key: a description of the detector, its threshold and the windows it detects
+		static std::string configuration(const std::string& detector, float threshold, const std::vector<ImageWindow>& windows)
+		{
+			std::ostringstream config;
+			config << "v" << version << ' ' << detector << ' ' << std::hexfloat << threshold;
+			for (const ImageWindow& window : windows)
+				config << ' ' << std::dec << window.x << ',' << window.y << ',' << window.width << ',' << window.height;
+			return config.str();
+		}
+
+		// Reads the entry 'key' into 'regions'; 'detected' is the keypoint count the detector saw before its budget
+		bool load(const std::string& key, std::unique_ptr<AKAZE_Binary_Regions>& regions, uint64_t& detected) const
+		{
+			MappedFile file(key);
+			if (file.size < sizeof(Header))
+				return false;
+			Header header;
+			std::memcpy(&header, file.data, sizeof(Header));
+			if (std::memcmp(header.magic, "FEAT", 4) != 0 || header.version != version
+				|| file.size != sizeof(Header) + header.count * (sizeof(FeatureRecord) + descriptorBytes))
+				return false;
+
+			regions.reset(new AKAZE_Binary_Regions);
+			regions->Features().resize(header.count);
+			regions->Descriptors().resize(header.count);
+			const unsigned char* features = file.data + sizeof(Header);
+			const unsigned char* descriptors = features + header.count * sizeof(FeatureRecord);
+			for (uint64_t i = 0; i < header.count; ++i) {
+				FeatureRecord f;
+				std::memcpy(&f, features + i * sizeof(FeatureRecord), sizeof(FeatureRecord));
+				regions->Features()[i] = SIOPointFeature(f.x, f.y, f.scale, f.orientation);
+				std::memcpy(&regions->Descriptors()[i], descriptors + i * descriptorBytes, descriptorBytes);
+			}
+			detected = header.detected;
+			return true;
+		}
+
+		void store(const std::string& key, const AKAZE_Binary_Regions& regions, uint64_t detected) const
+		{
+			Header header;
+			std::memcpy(header.magic, "FEAT", 4);
+			header.version = version;
+			header.count = regions.Features().size();
+			header.detected = detected;
+
+			std::vector<unsigned char> buffer(sizeof(Header) + header.count * (sizeof(FeatureRecord) + descriptorBytes));
+			std::memcpy(buffer.data(), &header, sizeof(Header));
+			unsigned char* features = buffer.data() + sizeof(Header);
+			unsigned char* descriptors = features + header.count * sizeof(FeatureRecord);
+			for (uint64_t i = 0; i < header.count; ++i) {
+				const SIOPointFeature& feature = regions.Features()[i];
+				const FeatureRecord f{ feature.x(), feature.y(), feature.scale(), feature.orientation() };
+				std::memcpy(features + i * sizeof(FeatureRecord), &f, sizeof(FeatureRecord));
+				std::memcpy(descriptors + i * descriptorBytes, &regions.Descriptors()[i], descriptorBytes);
+			}
+
+			std::ostringstream temporary;
+			temporary << key << ".tmp" << std::hash<std::thread::id>()(std::this_thread::get_id());
+			std::ofstream file(temporary.str(), std::ios::binary);
+			file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+			file.close();
+			if (!file || std::rename(temporary.str().c_str(), key.c_str()) != 0) {
+				std::cout << "Unable to write " << key << " to the feature cache" << std::endl;
+				std::remove(temporary.str().c_str());
+			}
+		}
+
+	private:
+		std::string directory;
+
+		// AKAZE_Binary_Regions descriptors, 512 bits
+		static constexpr size_t descriptorBytes = 64;
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint64_t count;
+			uint64_t detected;
+		};
+
+		struct FeatureRecord {
+			float x, y, scale, orientation;
+		};
+
+		// 64-bit FNV-1a over 8-byte words, then the tail bytes and the length
+		static uint64_t hash(const char* data, size_t size)
+		{
+			uint64_t h = 14695981039346656037ULL;
+			size_t i = 0;
+			for (; i + 8 <= size; i += 8) {
+				uint64_t word;
+				std::memcpy(&word, data + i, 8);
+				h = (h ^ word) * 1099511628211ULL;
+			}
+			for (; i < size; ++i)
+				h = (h ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+			return (h ^ size) * 1099511628211ULL;
+		}
+
+		// Read-only view of a whole file, empty if it doesn't exist
+		struct MappedFile {
+			const unsigned char* data = nullptr;
+			size_t size = 0;
+
+#ifndef _WIN32
+			explicit MappedFile(const std::string& path)
+			{
+				const int fd = open(path.c_str(), O_RDONLY);
+				if (fd < 0)
+					return;
+				struct stat st;
+				if (fstat(fd, &st) == 0 && st.st_size > 0) {
+					void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+					if (mapped != MAP_FAILED) {
+						data = static_cast<const unsigned char*>(mapped);
+						size = static_cast<size_t>(st.st_size);
+					}
+				}
+				close(fd);
+			}
+
+			~MappedFile()
+			{
+				if (data)
+					munmap(const_cast<unsigned char*>(data), size);
+			}
+#else
+			std::vector<unsigned char> buffer;
+
+			explicit MappedFile(const std::string& path)
+			{
+				std::ifstream file(path, std::ios::binary | std::ios::ate);
+				if (!file)
+					return;
+				buffer.resize(static_cast<size_t>(file.tellg()));
+				file.seekg(0);
+				if (!file.read(reinterpret_cast<char*>(buffer.data()), buffer.size()))
+					return;
+				data = buffer.data();
+				size = buffer.size();
+			}
+#endif
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+		};
+	};
+}
@@ -17,6 +17,7 @@
 #include <opencv2/features2d/features2d.hpp>
 
 #include "coloc/colocData.hpp"
+#include "coloc/DetectionROI.hpp"
 
 template <typename T, template <class> class ProcessorType>
 class FeatureDetector : public ProcessorType<T> {
@@ -26,9 +27,16 @@ public:
 	
 	}
 
-	T detectFeaturesFile(unsigned int idx, coloc::FeatureMap &regions, std::string &imageName)
+	// Empty windows detect the whole image. 'decoded', if given, is imageName already read into memory,
+	// and a non-zero 'contentHash' its FeatureCache::contentHash.
+	T detectFeaturesFile(unsigned int idx, coloc::FeatureMap &regions, std::string &imageName, const std::vector<coloc::ImageWindow> &windows = {}, const coloc::GrayImage *decoded = nullptr, uint64_t contentHash = 0)
 	{
-		return ProcessorType<T>::detectFeaturesFile(idx, regions, imageName);
+		return ProcessorType<T>::detectFeaturesFile(idx, regions, imageName, windows, decoded, contentHash);
+	}
+
+	T detectFeaturesImage(unsigned int idx, coloc::FeatureMap &regions, const coloc::GrayImage &image, const std::vector<coloc::ImageWindow> &windows = {})
+	{
+		return ProcessorType<T>::detectFeaturesImage(idx, regions, image, windows);
 	}
 
 #ifdef USE_STREAM
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "coloc/colocData.hpp"
+#include "coloc/FeatureCache.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace coloc
+{
+	// Reads and decodes the 'depth' frames after the current one of every drone on background threads, so that
+	// detection starts on an image that is already in memory. Decoded images come from a pool of
+	// buffers that are handed back with recycle() and reused for later frames.
+	//
+	// With hashContent, the workers also compute the FeatureCache::contentHash of every frame they
+	// read, so that looking it up in the feature cache doesn't read the file again.
+	//
+	// Frames are expected to be taken in increasing frame order; taking frame N drops the frames
+	// before N that nobody took (e.g. skipped in deadline mode). A frame that was never scheduled
+	// or already dropped is decoded by the caller instead.
+	class FramePrefetcher
+	{
+	public:
+		typedef std::function<std::string(int, unsigned int)> FrameName;
+
+		// Prefetches frames [first, end) of drones 0 .. numDrones - 1, named by frameName(id, number)
+		FramePrefetcher(FrameName frameName, unsigned int numDrones, unsigned int first, unsigned int end,
+			unsigned int depth, unsigned int numThreads, bool hashContent = false)
+			: frameName(frameName), numDrones(numDrones), end(end), depth(depth > 0 ? depth : 1), hashContent(hashContent), base(first), next(first)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			schedule();
+			for (unsigned int i = 0; i < std::max(numThreads, 1u); ++i)
+				workers.emplace_back([this]() { work(); });
+		}
+
+		~FramePrefetcher()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			queued.notify_all();
+			for (std::thread& worker : workers)
+				worker.join();
+		}
+
+		// Blocks until frame 'number' of drone 'id' is decoded. Returns false if it could not be read.
+		// 'contentHash', if given, is set to the frame's FeatureCache::contentHash, or 0 if it wasn't computed.
+		bool take(int id, unsigned int number, std::unique_ptr<GrayImage>& image, std::string& filename, uint64_t* contentHash = nullptr)
+		{
+			filename = frameName(id, number);
+			if (contentHash)
+				*contentHash = 0;
+			const Key key(number, id);
+			std::unique_lock<std::mutex> lock(mutex);
+			if (number > base) {
+				base = number;
+				drop();
+				schedule();
+			}
+
+			ready.wait(lock, [&]() {
+				auto it = slots.find(key);
+				return it == slots.end() || it->second.state == Slot::Ready || it->second.state == Slot::Failed;
+			});
+			auto it = slots.find(key);
+			if (it == slots.end()) {
+				image = pooled();
+				lock.unlock();
+				return ReadImage(filename.c_str(), image.get());
+			}
+
+			const bool loaded = it->second.state == Slot::Ready;
+			if (contentHash)
+				*contentHash = it->second.contentHash;
+			image = std::move(it->second.image);
+			slots.erase(it);
+			return loaded;
+		}
+
+		// Hands an image from take() back to the pool
+		void recycle(std::unique_ptr<GrayImage> image)
+		{
+			if (!image)
+				return;
+			std::lock_guard<std::mutex> lock(mutex);
+			pool.push_back(std::move(image));
+		}
+
+	private:
+		// (frame number, drone), in the order frames are needed
+		typedef std::pair<unsigned int, int> Key;
+
+		struct Slot {
+			enum State { Queued, Loading, Ready, Failed };
+			State state = Queued;
+			std::unique_ptr<GrayImage> image;
+			uint64_t contentHash = 0;
+		};
+
+		const FrameName frameName;
+		const unsigned int numDrones;
+		const unsigned int end;
+		const unsigned int depth;
+		const bool hashContent;
+
+		// Oldest frame still wanted, and the first one not scheduled yet
+		unsigned int base;
+		unsigned int next;
+		std::map<Key, Slot> slots;
+		std::vector<std::unique_ptr<GrayImage>> pool;
+		bool stopping = false;
+
+		std::mutex mutex;
+		std::condition_variable queued, ready;
+		std::vector<std::thread> workers;
+
+		// Schedules the frames up to depth frames past base
+		void schedule()
+		{
+			next = std::max(next, base);
+			bool added = false;
+			for (; next < end && next <= base + depth; ++next) {
+				for (unsigned int id = 0; id < numDrones; ++id)
+					slots[Key(next, static_cast<int>(id))];
+				added = true;
+			}
+			if (added)
+				queued.notify_all();
+		}
+
+		// Drops the finished and queued frames before base; the ones being loaded are dropped by their worker
+		void drop()
+		{
+			for (auto it = slots.begin(); it != slots.end() && it->first.first < base;) {
+				if (it->second.state == Slot::Loading) {
+					++it;
+					continue;
+				}
+				if (it->second.image)
+					pool.push_back(std::move(it->second.image));
+				it = slots.erase(it);
+			}
+		}
+
+		// A buffer from the pool, or a new one
+		std::unique_ptr<GrayImage> pooled()
+		{
+			if (pool.empty())
+				return std::unique_ptr<GrayImage>(new GrayImage);
+			std::unique_ptr<GrayImage> image = std::move(pool.back());
+			pool.pop_back();
+			return image;
+		}
+
+		void work()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			for (;;) {
+				// The oldest queued frame first
+				auto it = slots.begin();
+				while (it != slots.end() && it->second.state != Slot::Queued)
+					++it;
+				if (it == slots.end()) {
+					if (stopping)
+						return;
+					queued.wait(lock);
+					continue;
+				}
+				if (stopping)
+					return;
+
+				const Key key = it->first;
+				it->second.state = Slot::Loading;
+				std::unique_ptr<GrayImage> image = pooled();
+				lock.unlock();
+				const std::string filename = frameName(key.second, key.first);
+				const bool loaded = ReadImage(filename.c_str(), image.get());
+				uint64_t contentHash = 0;
+				if (loaded && hashContent)
+					FeatureCache::contentHash(filename, contentHash);
+				lock.lock();
+
+				// Frames before base were dropped while this one was loading
+				if (key.first < base) {
+					slots.erase(key);
+					pool.push_back(std::move(image));
+					continue;
+				}
+				Slot& slot = slots[key];
+				slot.image = std::move(image);
+				slot.contentHash = contentHash;
+				slot.state = loaded ? Slot::Ready : Slot::Failed;
+				ready.notify_all();
+			}
+		}
+	};
+}
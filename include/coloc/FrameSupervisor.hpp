@@ -0,0 +1,134 @@
+#pragma once
+
+#include "coloc/colocParams.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace coloc
+{
+	// Admission control for deadline mode. Frame n is taken to arrive n frame periods
+	// after tracking starts; the tracker always moves on to the newest frame that has
+	// arrived, and skips a frame outright when the expected processing time would take
+	// it past the latency budget. Every frame not processed is counted with its reason.
+	class FrameSupervisor
+	{
+	public:
+		enum DropReason { Superseded, Deadline, NumReasons };
+
+		FrameSupervisor(colocParams& _params, unsigned int _numDrones) : params(&_params), numDrones(_numDrones)
+		{ }
+
+		// Starts the camera clock so that frame 'number' arrives now
+		void start(unsigned int number)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			clockStart = Clock::now() - period() * number;
+		}
+
+		// Decides which frame to process next, starting from 'number'. Frames older than the
+		// newest one that has arrived are dropped. Returns false if the frame would miss its
+		// deadline; 'number' is then advanced past it.
+		bool admit(unsigned int& number)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			auto arrival = arrivalTime(number);
+			if (Clock::now() < arrival) {
+				lock.unlock();
+				std::this_thread::sleep_until(arrival);
+				lock.lock();
+			}
+
+			const unsigned int newest = std::min(newestArrived(), std::max(params->numFrames, 1u) - 1);
+			if (newest > number) {
+				drop(Superseded, newest - number);
+				number = newest;
+			}
+
+			const double age = elapsedMs(arrivalTime(number));
+			// Frames are only skipped for lateness if a fresh frame could make it in time
+			if (expectedMs < params->latencyBudgetMs && age + expectedMs > params->latencyBudgetMs) {
+				drop(Deadline, 1);
+				number++;
+				return false;
+			}
+
+			admitted[number] = Clock::now();
+			return true;
+		}
+
+		// Called once all drones are done with frame 'number'
+		void finished(unsigned int number)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			const double costMs = elapsedMs(admitted[number]);
+			admitted.erase(number);
+			expectedMs = processed == 0 ? costMs : 0.8 * expectedMs + 0.2 * costMs;
+			processed++;
+
+			const double latencyMs = elapsedMs(arrivalTime(number));
+			if (latencyMs > params->latencyBudgetMs) {
+				overruns++;
+				std::cout << "Frame " << number << " finished " << latencyMs << " ms after arrival, over the " << params->latencyBudgetMs << " ms budget" << std::endl;
+			}
+		}
+
+		void report()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::cout << "Frames processed per drone : " << processed << ", over budget : " << overruns << std::endl;
+			std::cout << "Frames dropped (all drones) : " << dropped[Superseded] << " superseded by a newer frame, "
+				<< dropped[Deadline] << " would have missed the deadline" << std::endl;
+		}
+
+		unsigned int droppedFrames(DropReason reason)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return dropped[reason];
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		colocParams* params;
+		unsigned int numDrones;
+		Clock::time_point clockStart = Clock::now();
+		// Admission times of the frames in flight
+		std::map <unsigned int, Clock::time_point> admitted;
+		double expectedMs = 0.0;
+		unsigned int processed = 0, overruns = 0;
+		unsigned int dropped[NumReasons] = {};
+		std::mutex mutex;
+
+		std::chrono::microseconds period() const
+		{
+			return std::chrono::microseconds(static_cast<long long>(params->framePeriodMs * 1000.0));
+		}
+
+		Clock::time_point arrivalTime(unsigned int number) const
+		{
+			return clockStart + period() * number;
+		}
+
+		unsigned int newestArrived() const
+		{
+			return static_cast<unsigned int>((Clock::now() - clockStart) / period());
+		}
+
+		static double elapsedMs(Clock::time_point since)
+		{
+			return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+		}
+
+		void drop(DropReason reason, unsigned int frames)
+		{
+			dropped[reason] += frames * numDrones;
+			std::cout << "Dropping " << frames << " frame(s) per drone : " << (reason == Superseded ? "superseded by a newer frame" : "would miss the latency budget") << std::endl;
+		}
+	};
+}
@@ -18,6 +18,10 @@
 #include "coloc/FeatureAngle.h"
 #include "coloc/Keypoint.h"
 #include "coloc/KFAST.h"
+#include "coloc/DetectionROI.hpp"
+#include "coloc/KeypointBudget.hpp"
+#include "coloc/ThresholdController.hpp"
+#include "coloc/PyramidDetection.hpp"
 #include <chrono>
 
 #include "coloc/colocData.hpp"
@@ -64,11 +68,13 @@ namespace coloc {
 		const unsigned int width;
 		const unsigned int height;
 		const unsigned int maxkp;
-		const uint8_t thresh;
+		// KFAST threshold of each drone
+		DroneThresholds thresholds;
+		const unsigned int budget_grid;
 
 	public:
 		GPUDetector(DetectorOptions opts) :
-			scale_factor(opts.scale_factor), scale_levels(opts.scale_levels), width(opts.width), height(opts.height), maxkp(opts.maxkp), thresh(opts.thresh)
+			scale_factor(opts.scale_factor), scale_levels(opts.scale_levels), width(opts.width), height(opts.height), maxkp(opts.maxkp), thresholds(opts.thresh, KFAST_minThreshold, KFAST_maxThreshold, opts.target_kp), budget_grid(opts.budget_grid)
 		{
 			// Setting cache and shared modes
 			cudaDeviceSetCacheConfig(cudaFuncCachePreferEqual);
@@ -155,15 +161,37 @@ namespace coloc {
 		}
 
 		// Process an image that is read from disk. converted_kps contains keypoints stored in OpenCV format.
-		T detectFeaturesFile(uint8_t idx, coloc::FeatureMap& regions, std::string &imageName)
+		// The device buffers are laid out for the full frame, so detection windows are ignored.
+		// 'decoded', if given, is imageName already read into memory, e.g. by a FramePrefetcher.
+		// There is no feature cache on the GPU, so 'contentHash' is unused.
+		T detectFeaturesFile(uint8_t idx, coloc::FeatureMap& regions, std::string &imageName, const std::vector<ImageWindow>& windows = {}, const GrayImage* decoded = nullptr, uint64_t contentHash = 0)
 		{
+			if (decoded)
+				return detectFeaturesImage(idx, regions, *decoded, windows);
+
 			cv::Mat image;
 			image = cv::imread(imageName, 0);
 			high_resolution_clock::time_point t1 = high_resolution_clock::now();
-			detectAndDescribe(image.data, image.cols, image.rows, thresh);
+			detectAndDescribe(image.data, image.cols, image.rows, thresholds[idx]);
 			high_resolution_clock::time_point t2 = high_resolution_clock::now();
 			std::cout << "Detected "<< kps.size() << " features in " << duration_cast<milliseconds>(t2 - t1).count() << " ms \n" << std::endl;
 
+			fillRegions(idx, regions);
+			return EXIT_SUCCESS;
+		}
+
+		// Process an image that is already in memory, e.g. handed over by a camera driver
+		T detectFeaturesImage(uint8_t idx, coloc::FeatureMap& regions, const GrayImage& image, const std::vector<ImageWindow>& windows = {})
+		{
+			detectAndDescribe(image.data(), image.Width(), image.Height(), thresholds[idx]);
+			fillRegions(idx, regions);
+			return EXIT_SUCCESS;
+		}
+
+	private:
+		// Converts the last detection (kps, desc) into regions[idx]
+		void fillRegions(uint8_t idx, coloc::FeatureMap& regions)
+		{
 			regions[idx] = std::unique_ptr <AKAZE_Binary_Regions>(new AKAZE_Binary_Regions);
 
 			regions[idx]->Features().resize(kps.size());
@@ -180,15 +208,15 @@ namespace coloc {
 
 				std::memcpy(&(regions[idx]->Descriptors()[i]), &(desc[i * 8]), 8 * sizeof(uint64_t));
 			}
-			return EXIT_SUCCESS;
 		}
 
+	public:
 #ifdef USE_STREAM
 		// Process an image that is obtained from a ROS topic. converted_kps contains keypoints stored in OpenCV format.
 		void detectFeaturesTopic(uint8_t idx, coloc::FeatureMap& regions, cv_bridge::CvImagePtr imagePtr) override
 		{
 			high_resolution_clock::time_point t1 = high_resolution_clock::now();
-			detectAndDescribe(imagePtr->image.data, imagePtr->image.cols, imagePtr->image.rows, thresh);
+			detectAndDescribe(imagePtr->image.data, imagePtr->image.cols, imagePtr->image.rows, thresholds[idx]);
 			high_resolution_clock::time_point t2 = high_resolution_clock::now();
 			ROS_INFO("Detected %d features in %ld ms \n", kps.size(), duration_cast<milliseconds>(t2 - t1).count());
 			converted_kps.clear();
@@ -213,8 +241,9 @@ namespace coloc {
 #endif
 
 	private:
-		void detectAndDescribe(const uint8_t* image, const uint32_t width, const uint32_t height, const uint8_t KFAST_thresh)
+		void detectAndDescribe(const uint8_t* image, const uint32_t width, const uint32_t height, ThresholdController& threshold)
 		{
+			const uint8_t KFAST_thresh = static_cast<uint8_t>(std::lround(threshold.value()));
 			// Clear keypoints, assign image and characteristics to the topmost level
 
 			kps.clear();
@@ -254,27 +283,26 @@ namespace coloc {
 				CUDALERP(d_img_tex_nf, f, f, levels[i].d_img, levels[i].pitch, levels[i].w, levels[i].h, stream[i - 1]);
 			}
 
-			// Initialize KFAST on the CPU
-
-			// Bring in downscale results from GPU (except for first level) 
-			// and operate on them as they arrive
-
+			// Bring in the downscaled levels, then detect on all of them at once
+			std::vector<const uint8_t*> images(scale_levels);
+			std::vector<uint32_t> widths(scale_levels), heights(scale_levels);
 			for (uint8_t i = 0; i < scale_levels; ++i) {
-				std::vector<Keypoint> local_kps;
-				if (i) {
+				if (i)
 					cudaMemcpy2DAsync(const_cast<uint8_t*>(levels[i].h_img), levels[i].w, levels[i].d_img, levels[i].pitch, levels[i].w, levels[i].h, cudaMemcpyDeviceToHost, stream[i - 1]);
-					cudaStreamSynchronize(stream[i - 1]);
-				}
-				KFAST<true, true>(levels[i].h_img, levels[i].w, levels[i].h, levels[i].w, local_kps, KFAST_thresh);
-
-				// set scale and compute angles
-				for (auto& kp : local_kps) {
-					kp.scale = i;
-					kp.angle = featureAngle(levels[i].h_img, kp.x, kp.y, static_cast<int>(levels[i].w));
-				}
-				//std::cout << "Got " << local_kps.size() << " keypoints from level " << +i << '.' << std::endl;
-				kps.insert(kps.end(), local_kps.begin(), local_kps.end());
+				images[i] = levels[i].h_img;
+				widths[i] = levels[i].w;
+				heights[i] = levels[i].h;
 			}
+			for (int i = 0; i < scale_levels - 1; ++i)
+				cudaStreamSynchronize(stream[i]);
+
+			detectPyramid(images.data(), widths.data(), heights.data(), scale_levels, KFAST_thresh, kps);
+			threshold.update(kps.size());
+			// Also keeps the keypoints within d_kps and d_desc, which hold maxkp of them
+			applyKeypointBudget(kps, maxkp, static_cast<float>(width), static_cast<float>(height), budget_grid, [this](const Keypoint& kp) {
+				const float scale = std::pow(scale_factor, kp.scale);
+				return BudgetPoint{ scale * kp.x, scale * kp.y, static_cast<float>(kp.score) };
+			});
 
 			// Compute LATCH descriptors for all the keypoints
 			cudaMemcpy(d_all_tex, all_tex, scale_levels * sizeof(cudaTextureObject_t), cudaMemcpyHostToDevice);
@@ -154,7 +154,7 @@ namespace coloc
 			return EXIT_SUCCESS;
 		}
 
-		void matchMapFeatures(std::unique_ptr<features::AKAZE_Binary_Regions>& map1, std::unique_ptr<features::AKAZE_Binary_Regions>& map2, IndMatches& commonFeatures)
+		void matchMapFeatures(const std::unique_ptr<features::AKAZE_Binary_Regions>& map1, const std::unique_ptr<features::AKAZE_Binary_Regions>& map2, IndMatches& commonFeatures)
 		{
 			commonFeatures = computeMatches(const_cast<unsigned int*>(static_cast<const unsigned int*>(map1->DescriptorRawData())),
 				const_cast<unsigned int*>(static_cast<const unsigned int*>(map2->DescriptorRawData())),
@@ -173,7 +173,12 @@ namespace coloc
 
 		void matchSceneWithMap(int& droneId, colocData& data, IndMatches& mapMatches)
 		{	
-			setQueryImage(data.regions[droneId]->RegionCount(), const_cast<unsigned int*>(static_cast<const unsigned int*>(data.regions[droneId]->DescriptorRawData())));
+			matchRegionsWithMap(data, *data.regions[droneId], mapMatches);
+		}
+
+		void matchRegionsWithMap(const colocData& data, const features::Regions& queryRegions, IndMatches& mapMatches)
+		{
+			setQueryImage(queryRegions.RegionCount(), const_cast<unsigned int*>(static_cast<const unsigned int*>(queryRegions.DescriptorRawData())));
 			mapMatches = matchFeaturesWithMap();
 		}
 
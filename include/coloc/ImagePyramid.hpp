@@ -0,0 +1,66 @@
+#pragma once
+
+#include "coloc/LERP.h"
+#include "coloc/ThreadPool.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace coloc
+{
+	// Scale pyramid for the KORAL detectors on the CPU. Level i is the input image downscaled
+	// by scale_factor^i, each level interpolated straight from the original as CUDALERP does.
+	// Buffers are allocated for the configured image size up front and reused from frame to
+	// frame; the levels are built concurrently, one per pool task.
+	class ImagePyramid
+	{
+	public:
+		ImagePyramid(float _scaleFactor, uint8_t _numLevels, uint32_t width, uint32_t height)
+			: scaleFactor(_scaleFactor), numLevels(_numLevels), buffers(_numLevels), images(_numLevels), widths(_numLevels), heights(_numLevels), factors(_numLevels)
+		{
+			resize(width, height);
+		}
+
+		void build(const uint8_t* image, uint32_t width, uint32_t height)
+		{
+			if (width != widths[0] || height != heights[0])
+				resize(width, height);
+
+			std::memcpy(buffers[0].data(), image, static_cast<size_t>(width) * height);
+
+			ThreadPool::instance().parallelFor(1, numLevels, [this](size_t i) {
+				LERP(buffers[0].data(), widths[0], heights[0], factors[i], factors[i], buffers[i].data(), widths[i], heights[i]);
+			});
+		}
+
+		uint8_t levels() const { return numLevels; }
+		const uint8_t* const* levelImages() const { return images.data(); }
+		const uint32_t* levelWidths() const { return widths.data(); }
+		const uint32_t* levelHeights() const { return heights.data(); }
+
+	private:
+		const float scaleFactor;
+		const uint8_t numLevels;
+		std::vector<std::vector<uint8_t>> buffers;
+		std::vector<const uint8_t*> images;
+		std::vector<uint32_t> widths, heights;
+		// Accumulated like GPUDetector does, so that the level sizes and sample positions match
+		std::vector<float> factors;
+
+		void resize(uint32_t width, uint32_t height)
+		{
+			float f = 1.0f;
+			for (uint8_t i = 0; i < numLevels; ++i) {
+				factors[i] = f;
+				widths[i] = static_cast<uint32_t>(static_cast<float>(width) / f + 0.5f);
+				heights[i] = static_cast<uint32_t>(static_cast<float>(height) / f + 0.5f);
+				// Padded for the vector loads of KFAST, LERP, LATCH and featureAngle past the last pixel
+				buffers[i].resize(static_cast<size_t>(widths[i]) * heights[i] + 64);
+				images[i] = buffers[i].data();
+				f *= scaleFactor;
+			}
+		}
+	};
+}
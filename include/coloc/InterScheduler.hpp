@@ -0,0 +1,130 @@
+#pragma once
+
+#include "coloc/colocData.hpp"
+#include "coloc/colocParams.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace coloc
+{
+	// Picks which inter-MAV pairs are worth running this cycle. Candidates are ranked by
+	// how much the destination drone needs a fix (covariance growth since its last
+	// inter-MAV fusion, few map matches), how reliable the source is (map matches) and
+	// how much the two cameras are predicted to see in common. The best pairs are taken
+	// until maxPairs is reached or their expected cost exceeds the cycle's time budget.
+	class InterScheduler
+	{
+	public:
+		struct Candidate {
+			Pair pair;
+			double score;
+			double overlap;
+		};
+
+		InterScheduler(colocParams& _params) : params(&_params)
+		{ }
+
+		std::vector <Pair> select(const std::vector <Pair>& candidates, const std::vector <int>& trackCounts,
+			const std::vector <Pose3>& poses, const std::vector <Cov6>& covs)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			std::vector <Candidate> ranked;
+			for (const Pair& pair : candidates) {
+				Candidate candidate;
+				candidate.pair = pair;
+				candidate.overlap = predictOverlap(poses[pair.first], poses[pair.second]);
+				candidate.score = score(pair, trackCounts, covs, candidate.overlap);
+				if (candidate.overlap > 0.0)
+					ranked.push_back(candidate);
+			}
+			std::stable_sort(ranked.begin(), ranked.end(), [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+
+			std::vector <Pair> selected;
+			double plannedMs = 0.0;
+			for (const Candidate& candidate : ranked) {
+				if (selected.size() >= params->interMaxPairs)
+					break;
+
+				// The first pair always runs so that an over-tight budget cannot starve fusion
+				const double costMs = expectedCost(candidate.pair);
+				if (!selected.empty() && plannedMs + costMs > params->interBudgetMs)
+					continue;
+
+				std::cout << "Scheduling inter-MAV pair " << candidate.pair.first << " & " << candidate.pair.second
+					<< " (score " << candidate.score << ", overlap " << candidate.overlap << ", ~" << costMs << " ms)" << std::endl;
+				selected.push_back(candidate.pair);
+				plannedMs += costMs;
+			}
+			return selected;
+		}
+
+		// Running average of the time one estimate of this pair takes
+		void recordCost(const Pair& pair, double ms)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto cost = costs.find(pair);
+			if (cost == costs.end())
+				costs[pair] = ms;
+			else
+				cost->second = 0.7 * cost->second + 0.3 * ms;
+		}
+
+		// Resets the covariance growth of a drone once an inter-MAV estimate was fused into it
+		void recordFusion(int destId, const Cov6& cov)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			fusedUncertainty[destId] = positionUncertainty(cov);
+		}
+
+	private:
+		colocParams* params;
+		std::map <Pair, double> costs;
+		std::map <int, double> fusedUncertainty;
+		std::mutex mutex;
+
+		static double positionUncertainty(const Cov6& cov)
+		{
+			return cov[21] + cov[28] + cov[35];
+		}
+
+		double score(const Pair& pair, const std::vector <int>& trackCounts, const std::vector <Cov6>& covs, double overlap)
+		{
+			const double uncertainty = positionUncertainty(covs[pair.second]);
+			auto fused = fusedUncertainty.find(pair.second);
+			// Drones never helped by an inter-MAV estimate count their whole uncertainty as growth
+			const double growth = std::max(0.0, uncertainty - (fused == fusedUncertainty.end() ? 0.0 : fused->second));
+
+			const double sourceQuality = std::min(1.0, trackCounts[pair.first] / 100.0);
+			const double destNeed = 1.0 - std::min(1.0, trackCounts[pair.second] / 100.0);
+
+			return overlap * sourceQuality * (1.0 + destNeed + growth);
+		}
+
+		// Overlap predicted from the current poses: cameras looking the same way from nearby
+		// positions share most of their view. 0 when they face away from each other.
+		double predictOverlap(const Pose3& source, const Pose3& dest) const
+		{
+			// Optical axes in world coordinates (third row of the world-to-camera rotation)
+			const Vec3 axisSource = source.rotation().row(2).transpose();
+			const Vec3 axisDest = dest.rotation().row(2).transpose();
+
+			const double alignment = axisSource.dot(axisDest);
+			if (alignment <= 0.0)
+				return 0.0;
+
+			const double distance = (source.center() - dest.center()).norm();
+			return alignment / (1.0 + distance / params->overlapDistance);
+		}
+
+		double expectedCost(const Pair& pair) const
+		{
+			auto cost = costs.find(pair);
+			return cost == costs.end() ? 0.0 : cost->second;
+		}
+	};
+}
@@ -1,5 +1,9 @@
 #include "coloc/colocInterface.hpp"
 #include "coloc/FeatureDetector.hpp"
+#include "coloc/FramePrefetcher.hpp"
+#include "coloc/ThreadPool.hpp"
+
+#include <mutex>
 
 namespace coloc
 {
@@ -10,26 +14,99 @@ namespace coloc
 
 		void processImageSingle(int &id) override
 		{
-			std::string number = std::string(4 - std::to_string(imageNumber).length(), '0') + std::to_string(imageNumber);  //std::to_string(imageNumber); //std::string(4 - std::to_string(imageNumber).length(), '0') + std::to_string(imageNumber);
-			data->filenames[id] = params->imageFolder + "img__Quad" + std::to_string(id) + "_" + number + ".png";  //"image (" + number + ").png";
-			detector.detectFeaturesFile(id, data->regions, data->filenames[id]);
+			processImageSingle(id, imageNumber, data->regions, data->filenames[id]);
 			data->scene.views[id].reset(new View(data->filenames[id], id, 0, id, params->imageSize.first, params->imageSize.second));
 		}
 
+		// Detects frame 'number' into caller-owned regions and leaves the scene untouched,
+		// so it is safe to call for different drones or frames concurrently.
+		void processImageSingle(int &id, unsigned int number, FeatureMap &regions, std::string &filename) override
+		{
+			if (params->prefetchDepth == 0) {
+				filename = frameFilename(id, number);
+				detector.detectFeaturesFile(id, regions, filename, detectionWindows.get(id));
+				return;
+			}
+
+			std::unique_ptr<GrayImage> image;
+			uint64_t contentHash;
+			const bool loaded = prefetcher(number).take(id, number, image, filename, &contentHash);
+			detector.detectFeaturesFile(id, regions, filename, detectionWindows.get(id), loaded ? image.get() : nullptr, loaded ? contentHash : 0);
+			prefetcher(number).recycle(std::move(image));
+		}
+
+		bool readFrame(int id, unsigned int number, GrayImage &image, std::string &filename) override
+		{
+			if (params->prefetchDepth > 0) {
+				std::unique_ptr<GrayImage> prefetched;
+				const bool loaded = prefetcher(number).take(id, number, prefetched, filename);
+				if (loaded)
+					image.swap(*prefetched);
+				prefetcher(number).recycle(std::move(prefetched));
+				if (!loaded) {
+					std::cout << "Unable to read image from the given path." << std::endl;
+					return EXIT_FAILURE;
+				}
+				return EXIT_SUCCESS;
+			}
+
+			filename = frameFilename(id, number);
+			if (!ReadImage(filename.c_str(), &image)) {
+				std::cout << "Unable to read image from the given path." << std::endl;
+				return EXIT_FAILURE;
+			}
+			return EXIT_SUCCESS;
+		}
+
+		void processImageSingle(int id, FeatureMap &regions, const GrayImage &image) override
+		{
+			detector.detectFeaturesImage(id, regions, image, detectionWindows.get(id));
+		}
+
+		// Detects the first image of every drone at once, each into its own FeatureMap; the
+		// results are moved into the shared regions and scene afterwards, on this thread.
 		void processImages(std::vector <int>& droneIds) override
 		{
-			std::vector <std::string> filename;
-			std::string number = std::string(4 - std::to_string(imageNumber).length(), '0') + std::to_string(imageNumber);
-			auto start = std::chrono::system_clock::now();
-			for (unsigned int i = 0; i < droneIds.size(); ++i) {
-				data->filenames[i] = params->imageFolder + "img__Quad" + std::to_string(droneIds[i]) + "_" + number + ".png";
+			std::vector <FeatureMap> droneRegions(droneIds.size());
+			auto detect = [&](size_t i) {
+				data->filenames[i] = frameFilename(droneIds[i], imageNumber);
 				std::cout << data->filenames[i] << std::endl;
+				detector.detectFeaturesFile(i, droneRegions[i], data->filenames[i]);
+			};
+#ifdef USE_CUDA
+			// The GPU detector shares device buffers between calls
+			for (size_t i = 0; i < droneIds.size(); ++i)
+				detect(i);
+#else
+			ThreadPool::instance().parallelFor(0, droneIds.size(), detect);
+#endif
 
-				detector.detectFeaturesFile(i, data->regions, data->filenames[i]);
-				//detector.saveFeatureData(i, data.regions, filename[i]);
-
+			for (unsigned int i = 0; i < droneIds.size(); ++i) {
+				auto detected = droneRegions[i].find(i);
+				if (detected != droneRegions[i].end())
+					data->regions[i] = std::move(detected->second);
 				data->scene.views[i].reset(new View(data->filenames[i], i, 0, i, params->imageSize.first, params->imageSize.second));
 			}
 		}
+
+	private:
+		std::once_flag prefetcherStarted;
+		std::unique_ptr<FramePrefetcher> framePrefetcher;
+
+		// Started by the first frame that is asked for, once the drones are known
+		FramePrefetcher& prefetcher(unsigned int first)
+		{
+			std::call_once(prefetcherStarted, [&]() {
+				framePrefetcher.reset(new FramePrefetcher([this](int id, unsigned int number) { return frameFilename(id, number); },
+					data->numDrones, first, params->numFrames, params->prefetchDepth, params->prefetchThreads, cachedFeatures));
+			});
+			return *framePrefetcher;
+		}
+
+		std::string frameFilename(int id, unsigned int number) const
+		{
+			std::string numberStr = std::string(4 - std::to_string(number).length(), '0') + std::to_string(number);  //std::to_string(imageNumber); //std::string(4 - std::to_string(imageNumber).length(), '0') + std::to_string(imageNumber);
+			return params->imageFolder + "img__Quad" + std::to_string(id) + "_" + numberStr + ".png";  //"image (" + number + ").png";
+		}
 	};
 }
\ No newline at end of file
@@ -152,21 +152,31 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <future>
 #include <immintrin.h>
 #include <vector>
 
+#include "CPUDispatch.h"
 #include "Keypoint.h"
+#include "coloc/ThreadPool.hpp"
+
+// Range an adaptive threshold is kept in: below it sensor noise passes as corners,
+// above it hardly anything does
+constexpr float KFAST_minThreshold = 5.0f;
+constexpr float KFAST_maxThreshold = 150.0f;
+
+#ifdef _MSC_VER
+#define KFAST_FORCEINLINE __forceinline
+#else
+#define KFAST_FORCEINLINE inline __attribute__((always_inline))
+#endif
 
 // Yes, this function MUST be inlined.
 // Even if your compiler thinks otherwise.
 // 2000 -> 2600 microseconds without forced inlining.
 template<const bool full, const bool nonmax_suppression>
-#ifdef _MSC_VER
-__forceinline
-#else
-inline __attribute__((always_inline))
-#endif
+KFAST_FORCEINLINE KORAL_TARGET_AVX2
 void processCols(int32_t& num_corners, const uint8_t* __restrict & ptr, int32_t& j,
 	const int32_t* const __restrict offsets, const __m256i& ushft, const __m256i& t, const int32_t cols,
 	const __m256i& consec, int32_t* const __restrict corners, uint8_t* const __restrict cur,
@@ -240,7 +250,8 @@ void processCols(int32_t& num_corners, const uint8_t* __restrict & ptr, int32_t&
 	// the normal full 32 columns, or special handling for the last few columns if they
 	// don't divide up evenly into 32
 	uint32_t last_cols_mask;
-	if (!full) last_cols_mask = (1 << (cols - j - 3)) - 1;
+	// 64-bit shift: exactly 32 columns may be left
+	if (!full) last_cols_mask = static_cast<uint32_t>((1ULL << (cols - j - 3)) - 1);
 
 	// 'mask' now contains one bit for each element
 	// which is SET if that element COULD be a corner based on the 2 consective cardinal point test
@@ -382,16 +393,12 @@ void processCols(int32_t& num_corners, const uint8_t* __restrict & ptr, int32_t&
 	}
 }
 
-template <const bool nonmax_suppression, const bool first_thread, const bool last_thread>
-void _KFAST(const uint8_t* __restrict const data, const int32_t cols, const int32_t start_row, const int32_t rows, const int32_t stride,
-	std::vector<Keypoint>& keypoints, const uint8_t threshold) {
-	keypoints.reserve(8500);
-
-	// Rosten's circle pixels in the order 9, 8, 7, 6, 5, 4, 3, 2, 1, 16, 15, 14, 13, 12, 11, 10, then repeat 9, 8, 7, 6, 5, 4, 3, 2
-	const int32_t offsets[24] = { 3 * stride, 3 * stride + 1, 2 * stride + 2, stride + 3, 3, -stride + 3, -2 * stride + 2,
-		-3 * stride + 1, -3 * stride, -3 * stride - 1, -2 * stride - 2, -stride - 3, -3, stride - 3, 2 * stride - 2,
-		3 * stride - 1, 3 * stride, 3 * stride + 1, 2 * stride + 2, stride + 3, 3, -stride + 3, -2 * stride + 2, -3 * stride + 1 };
-
+// Scans the candidate columns of row i, 32 at a time
+template <const bool nonmax_suppression>
+KORAL_TARGET_AVX2
+void KFAST_row_AVX2(const uint8_t* __restrict const data, const int32_t cols, const int32_t stride, const int32_t* const __restrict offsets,
+	const uint8_t threshold, const int32_t i, const int32_t start_row, int32_t& num_corners, int32_t* const __restrict corners,
+	uint8_t* const __restrict cur, std::vector<Keypoint>& keypoints) {
 	// no epu8 comparisons so in order to do them we must use epi8 comparisons and shift everything down by 128
 	// add, xor, and sub 128 all do the same thing. Do it to both comparands before epi8 comparison to get
 	// the equivalent unshifted epu8 comparison.
@@ -404,6 +411,312 @@ void _KFAST(const uint8_t* __restrict const data, const int32_t cols, const int3
 	// will be used for comparing number of consecutive salient pixels - greater than 8 means corner!
 	const __m256i consec = _mm256_set1_epi8(8);
 
+	// ptr points to the first valid offsets in the row but hasn't retrieved it yet
+	const uint8_t* ptr = data + i*stride + 3;
+
+	// for col (3) to (cols - 35)
+	// jumping forward 32 cols at a time and also moving ptr forward 32 cols each time with it
+	// these calls to processCols MUST be inlined for best performance, even if your compiler thinks otherwise
+	int32_t j;
+	for (j = 3; j < cols - 35; j += 32, ptr += 32) {
+		processCols<true, nonmax_suppression>(num_corners, ptr, j, offsets, ushft, t,
+			cols, consec, corners, cur, keypoints, i, start_row);
+	}
+	// handle last few columns
+	processCols<false, nonmax_suppression>(num_corners, ptr, j, offsets, ushft, t,
+		cols, consec, corners, cur, keypoints, i, start_row);
+}
+
+// Corner score with AVX-512 enabled, same arcs and reduction as processCols
+KORAL_TARGET_AVX512
+inline uint8_t KFAST_score_AVX512(const uint8_t* const ptrpk, const int32_t* const __restrict offsets) {
+	const int16_t p = static_cast<int16_t>(*ptrpk);
+	int16_t ring[24];
+	for (int n = 0; n < 24; ++n) ring[n] = p - static_cast<int16_t>(ptrpk[offsets[n]]);
+
+	__m256i minv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ring));
+	__m256i maxv = minv;
+	for (int n = 1; n < 9; ++n) {
+		const __m256i ringv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ring + n));
+		minv = _mm256_min_epi16(minv, ringv);
+		maxv = _mm256_max_epi16(maxv, ringv);
+	}
+	maxv = _mm256_max_epi16(minv, _mm256_sub_epi16(_mm256_setzero_si256(), maxv));
+	return static_cast<uint8_t>(_mm_cvtsi128_si32(_mm_sub_epi16(_mm_set1_epi16(32767),
+		_mm_minpos_epu16(_mm_sub_epi16(_mm_set1_epi16(32767),
+			_mm_max_epi16(_mm256_extracti128_si256(maxv, 1), _mm256_castsi256_si128(maxv)))))));
+}
+
+// processCols for 64 pixels at a time. AVX-512BW has unsigned byte comparisons into mask
+// registers, so no shift by 128 is needed, and the last columns are read with masked loads.
+template<const bool full, const bool nonmax_suppression>
+KFAST_FORCEINLINE KORAL_TARGET_AVX512
+void processCols_AVX512(int32_t& num_corners, const uint8_t* __restrict const ptr, const int32_t j,
+	const int32_t* const __restrict offsets, const __m512i& t, const int32_t cols, const __m512i& consec,
+	int32_t* const __restrict corners, uint8_t* const __restrict cur, std::vector<Keypoint>& keypoints,
+	const int32_t i, const int32_t start_row) {
+	// columns j to cols - 4, at most 64 of them are left here
+	const __mmask64 valid = full ? ~0ULL : _bzhi_u64(~0ULL, static_cast<uint32_t>(std::max(cols - j - 3, 0)));
+
+	const __m512i p = _mm512_maskz_loadu_epi8(valid, ptr);
+	const __m512i ppt = _mm512_adds_epu8(p, t);
+	const __m512i pmt = _mm512_subs_epu8(p, t);
+
+	// Rosten's points 9, 5, 1 and 13: a corner has two consecutive ones on the same side
+	const __m512i p9 = _mm512_maskz_loadu_epi8(valid, ptr + offsets[0]);
+	const __m512i p5 = _mm512_maskz_loadu_epi8(valid, ptr + offsets[4]);
+	const __m512i p1 = _mm512_maskz_loadu_epi8(valid, ptr + offsets[8]);
+	const __m512i p13 = _mm512_maskz_loadu_epi8(valid, ptr + offsets[12]);
+
+	const __mmask64 b9 = _mm512_cmpgt_epu8_mask(p9, ppt), b5 = _mm512_cmpgt_epu8_mask(p5, ppt);
+	const __mmask64 b1 = _mm512_cmpgt_epu8_mask(p1, ppt), b13 = _mm512_cmpgt_epu8_mask(p13, ppt);
+	const __mmask64 d9 = _mm512_cmplt_epu8_mask(p9, pmt), d5 = _mm512_cmplt_epu8_mask(p5, pmt);
+	const __mmask64 d1 = _mm512_cmplt_epu8_mask(p1, pmt), d13 = _mm512_cmplt_epu8_mask(p13, pmt);
+
+	uint64_t m = valid & ((b9 & b5) | (b5 & b1) | (b1 & b13) | (b13 & b9) | (d9 & d5) | (d5 & d1) | (d1 & d13) | (d13 & d9));
+	if (m == 0) return;
+
+	// lengths of the current and longest runs of brighter and darker pixels
+	const __m512i one = _mm512_set1_epi8(1);
+	__m512i ppt_cnt = _mm512_setzero_si512();
+	__m512i pmt_cnt = _mm512_setzero_si512();
+	__m512i ppt_max = _mm512_setzero_si512();
+	__m512i pmt_max = _mm512_setzero_si512();
+	for (int32_t k = 0; k < 24; ++k) {
+		const __m512i c = _mm512_maskz_loadu_epi8(valid, ptr + offsets[k]);
+
+		// runs continue where the pixel is salient and are zeroed where it is not
+		ppt_cnt = _mm512_maskz_add_epi8(_mm512_cmpgt_epu8_mask(c, ppt), ppt_cnt, one);
+		pmt_cnt = _mm512_maskz_add_epi8(_mm512_cmplt_epu8_mask(c, pmt), pmt_cnt, one);
+		ppt_max = _mm512_max_epu8(ppt_max, ppt_cnt);
+		pmt_max = _mm512_max_epu8(pmt_max, pmt_cnt);
+	}
+
+	m = valid & _mm512_cmpgt_epu8_mask(_mm512_max_epu8(ppt_max, pmt_max), consec);
+
+	while (m) {
+		const uint32_t x = static_cast<uint32_t>(_tzcnt_u64(m));
+		m = _blsr_u64(m);
+		if (nonmax_suppression) {
+			corners[num_corners++] = j + x;
+			cur[j + x] = KFAST_score_AVX512(ptr + x, offsets);
+		}
+		else {
+			keypoints.emplace_back(j + x, start_row + i, 0);
+		}
+	}
+}
+
+template <const bool nonmax_suppression>
+KORAL_TARGET_AVX512
+void KFAST_row_AVX512(const uint8_t* __restrict const data, const int32_t cols, const int32_t stride, const int32_t* const __restrict offsets,
+	const uint8_t threshold, const int32_t i, const int32_t start_row, int32_t& num_corners, int32_t* const __restrict corners,
+	uint8_t* const __restrict cur, std::vector<Keypoint>& keypoints) {
+	const __m512i t = _mm512_set1_epi8(threshold);
+	const __m512i consec = _mm512_set1_epi8(8);
+
+	const uint8_t* ptr = data + i*stride + 3;
+	int32_t j;
+	for (j = 3; j < cols - 67; j += 64, ptr += 64) {
+		processCols_AVX512<true, nonmax_suppression>(num_corners, ptr, j, offsets, t, cols, consec,
+			corners, cur, keypoints, i, start_row);
+	}
+	processCols_AVX512<false, nonmax_suppression>(num_corners, ptr, j, offsets, t, cols, consec,
+		corners, cur, keypoints, i, start_row);
+}
+
+// Non-max suppression of row y, whose scores are in 'last', 64 columns at a time. Columns
+// without a corner have a score of 0 and can never win, so no corner list is needed.
+KORAL_TARGET_AVX512
+inline void KFAST_nms_AVX512(const uint8_t* const __restrict last2, const uint8_t* const __restrict last, const uint8_t* const __restrict cur,
+	const int32_t cols, const int32_t y, std::vector<Keypoint>& keypoints) {
+	for (int32_t j = 1; j < cols - 1; j += 64) {
+		// bzhi only looks at the low byte of the index
+		const __mmask64 valid = _bzhi_u64(~0ULL, static_cast<uint32_t>(std::min(cols - 1 - j, 64)));
+		const __m512i score = _mm512_maskz_loadu_epi8(valid, last + j);
+		uint64_t m = _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, last + j - 1))
+			& _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, last + j + 1))
+			& _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, cur + j - 1))
+			& _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, cur + j))
+			& _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, cur + j + 1))
+			& _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, last2 + j - 1))
+			& _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, last2 + j))
+			& _mm512_cmpgt_epu8_mask(score, _mm512_maskz_loadu_epi8(valid, last2 + j + 1));
+		while (m) {
+			const int32_t x = static_cast<int32_t>(_tzcnt_u64(m));
+			m = _blsr_u64(m);
+			keypoints.emplace_back(j + x, y, last[j + x]);
+		}
+	}
+}
+
+// Corner score of the SSE and scalar paths, same as the AVX2 one: the largest deviation from p
+// that all 9 pixels of one of the 16 arcs of the circle exceed
+KORAL_TARGET_SSE42
+inline uint8_t KFAST_score_SSE(const uint8_t* const ptrpk, const int32_t* const __restrict offsets) {
+	const int16_t p = static_cast<int16_t>(*ptrpk);
+	int16_t ring[24];
+	for (int n = 0; n < 24; ++n) ring[n] = p - static_cast<int16_t>(ptrpk[offsets[n]]);
+
+	// arcs starting at 0-7 and at 8-15
+	__m128i minlo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ring));
+	__m128i maxlo = minlo;
+	__m128i minhi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ring + 8));
+	__m128i maxhi = minhi;
+	for (int n = 1; n < 9; ++n) {
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ring + n));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ring + 8 + n));
+		minlo = _mm_min_epi16(minlo, lo);
+		maxlo = _mm_max_epi16(maxlo, lo);
+		minhi = _mm_min_epi16(minhi, hi);
+		maxhi = _mm_max_epi16(maxhi, hi);
+	}
+	const __m128i maxv = _mm_max_epi16(_mm_max_epi16(minlo, _mm_sub_epi16(_mm_setzero_si128(), maxlo)),
+		_mm_max_epi16(minhi, _mm_sub_epi16(_mm_setzero_si128(), maxhi)));
+	return static_cast<uint8_t>(_mm_cvtsi128_si32(_mm_sub_epi16(_mm_set1_epi16(32767),
+		_mm_minpos_epu16(_mm_sub_epi16(_mm_set1_epi16(32767), maxv)))));
+}
+
+// processCols for 16 pixels at a time with SSE4
+template<const bool full, const bool nonmax_suppression>
+KFAST_FORCEINLINE KORAL_TARGET_SSE42
+void processCols_SSE(int32_t& num_corners, const uint8_t* __restrict & ptr, int32_t& j,
+	const int32_t* const __restrict offsets, const __m128i& ushft, const __m128i& t, const int32_t cols,
+	const __m128i& consec, int32_t* const __restrict corners, uint8_t* const __restrict cur,
+	std::vector<Keypoint>& keypoints, const int32_t i, const int32_t start_row) {
+	__m128i ppt = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+	const __m128i pmt = _mm_xor_si128(_mm_subs_epu8(ppt, t), ushft);
+	ppt = _mm_xor_si128(_mm_adds_epu8(ppt, t), ushft);
+
+	// Rosten's points 9, 5, 1 and 13: a corner has two consecutive ones on the same side
+	const __m128i p9 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + offsets[0])), ushft);
+	const __m128i p5 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + offsets[4])), ushft);
+	const __m128i p1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + offsets[8])), ushft);
+	const __m128i p13 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + offsets[12])), ushft);
+
+	const __m128i b9 = _mm_cmpgt_epi8(p9, ppt), b5 = _mm_cmpgt_epi8(p5, ppt), b1 = _mm_cmpgt_epi8(p1, ppt), b13 = _mm_cmpgt_epi8(p13, ppt);
+	const __m128i d9 = _mm_cmpgt_epi8(pmt, p9), d5 = _mm_cmpgt_epi8(pmt, p5), d1 = _mm_cmpgt_epi8(pmt, p1), d13 = _mm_cmpgt_epi8(pmt, p13);
+	const __m128i ppt_accum = _mm_or_si128(_mm_or_si128(_mm_and_si128(b9, b5), _mm_and_si128(b5, b1)), _mm_or_si128(_mm_and_si128(b1, b13), _mm_and_si128(b13, b9)));
+	const __m128i pmt_accum = _mm_or_si128(_mm_or_si128(_mm_and_si128(d9, d5), _mm_and_si128(d5, d1)), _mm_or_si128(_mm_and_si128(d1, d13), _mm_and_si128(d13, d9)));
+
+	uint32_t last_cols_mask;
+	if (!full) last_cols_mask = (1U << (cols - j - 3)) - 1;
+
+	uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(ppt_accum, pmt_accum)));
+	if (!full) m &= last_cols_mask;
+	if (m == 0) return;
+
+	__m128i ppt_cnt = _mm_setzero_si128();
+	__m128i pmt_cnt = _mm_setzero_si128();
+	__m128i ppt_max = _mm_setzero_si128();
+	__m128i pmt_max = _mm_setzero_si128();
+	for (int32_t k = 0; k < 24; ++k) {
+		const __m128i p = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + offsets[k])), ushft);
+		const __m128i brighter = _mm_cmpgt_epi8(p, ppt);
+		const __m128i darker = _mm_cmpgt_epi8(pmt, p);
+		ppt_max = _mm_max_epu8(ppt_max, ppt_cnt = _mm_and_si128(_mm_sub_epi8(ppt_cnt, brighter), brighter));
+		pmt_max = _mm_max_epu8(pmt_max, pmt_cnt = _mm_and_si128(_mm_sub_epi8(pmt_cnt, darker), darker));
+	}
+
+	m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_max_epu8(ppt_max, pmt_max), consec)));
+	if (!full) m &= last_cols_mask;
+
+	while (m) {
+		const uint32_t x = KORAL_ctz(m);
+		m &= m - 1;
+		if (nonmax_suppression) {
+			corners[num_corners++] = j + x;
+			cur[j + x] = KFAST_score_SSE(ptr + x, offsets);
+		}
+		else {
+			keypoints.emplace_back(j + x, start_row + i, 0);
+		}
+	}
+}
+
+template <const bool nonmax_suppression>
+KORAL_TARGET_SSE42
+void KFAST_row_SSE(const uint8_t* __restrict const data, const int32_t cols, const int32_t stride, const int32_t* const __restrict offsets,
+	const uint8_t threshold, const int32_t i, const int32_t start_row, int32_t& num_corners, int32_t* const __restrict corners,
+	uint8_t* const __restrict cur, std::vector<Keypoint>& keypoints) {
+	const __m128i ushft = _mm_set1_epi8(-128);
+	const __m128i t = _mm_set1_epi8(threshold);
+	const __m128i consec = _mm_set1_epi8(8);
+
+	const uint8_t* ptr = data + i*stride + 3;
+	int32_t j;
+	for (j = 3; j < cols - 19; j += 16, ptr += 16) {
+		processCols_SSE<true, nonmax_suppression>(num_corners, ptr, j, offsets, ushft, t,
+			cols, consec, corners, cur, keypoints, i, start_row);
+	}
+	processCols_SSE<false, nonmax_suppression>(num_corners, ptr, j, offsets, ushft, t,
+		cols, consec, corners, cur, keypoints, i, start_row);
+}
+
+inline uint8_t KFAST_score_scalar(const uint8_t* const ptrpk, const int32_t* const __restrict offsets) {
+	const int16_t p = static_cast<int16_t>(*ptrpk);
+	int16_t ring[24];
+	for (int n = 0; n < 24; ++n) ring[n] = p - static_cast<int16_t>(ptrpk[offsets[n]]);
+
+	int16_t score = INT16_MIN;
+	for (int s = 0; s < 16; ++s) {
+		int16_t lo = ring[s], hi = ring[s];
+		for (int n = s + 1; n < s + 9; ++n) {
+			lo = std::min(lo, ring[n]);
+			hi = std::max(hi, ring[n]);
+		}
+		score = std::max(score, std::max(lo, static_cast<int16_t>(-hi)));
+	}
+	return static_cast<uint8_t>(score);
+}
+
+// Portable fallback, one pixel at a time with the same tests as the vector paths
+template <const bool nonmax_suppression>
+void KFAST_row_scalar(const uint8_t* __restrict const data, const int32_t cols, const int32_t stride, const int32_t* const __restrict offsets,
+	const uint8_t threshold, const int32_t i, const int32_t start_row, int32_t& num_corners, int32_t* const __restrict corners,
+	uint8_t* const __restrict cur, std::vector<Keypoint>& keypoints) {
+	const uint8_t* const row = data + i*stride;
+	for (int32_t j = 3; j < cols - 3; ++j) {
+		const uint8_t* const ptr = row + j;
+		const int32_t bright = std::min(*ptr + threshold, 255);
+		const int32_t dark = std::max(*ptr - threshold, 0);
+
+		// two consecutive of Rosten's points 9, 5, 1 and 13 must be on the same side
+		const int32_t c9 = ptr[offsets[0]], c5 = ptr[offsets[4]], c1 = ptr[offsets[8]], c13 = ptr[offsets[12]];
+		const bool maybe_bright = (c9 > bright && c5 > bright) || (c5 > bright && c1 > bright) || (c1 > bright && c13 > bright) || (c13 > bright && c9 > bright);
+		const bool maybe_dark = (c9 < dark && c5 < dark) || (c5 < dark && c1 < dark) || (c1 < dark && c13 < dark) || (c13 < dark && c9 < dark);
+		if (!maybe_bright && !maybe_dark) continue;
+
+		int32_t bright_cnt = 0, dark_cnt = 0, longest = 0;
+		for (int32_t k = 0; k < 24; ++k) {
+			const int32_t c = ptr[offsets[k]];
+			bright_cnt = c > bright ? bright_cnt + 1 : 0;
+			dark_cnt = c < dark ? dark_cnt + 1 : 0;
+			longest = std::max(longest, std::max(bright_cnt, dark_cnt));
+		}
+		if (longest <= 8) continue;
+
+		if (nonmax_suppression) {
+			corners[num_corners++] = j;
+			cur[j] = KFAST_score_scalar(ptr, offsets);
+		}
+		else {
+			keypoints.emplace_back(j, start_row + i, 0);
+		}
+	}
+}
+
+// 'isa' is only given to compare the code paths, e.g. in benchmarks
+template <const bool nonmax_suppression, const bool first_thread, const bool last_thread>
+void _KFAST(const uint8_t* __restrict const data, const int32_t cols, const int32_t start_row, const int32_t rows, const int32_t stride,
+	std::vector<Keypoint>& keypoints, const uint8_t threshold, const KORAL_ISA isa = KORAL_isa()) {
+	keypoints.reserve(8500);
+
+	// Rosten's circle pixels in the order 9, 8, 7, 6, 5, 4, 3, 2, 1, 16, 15, 14, 13, 12, 11, 10, then repeat 9, 8, 7, 6, 5, 4, 3, 2
+	const int32_t offsets[24] = { 3 * stride, 3 * stride + 1, 2 * stride + 2, stride + 3, 3, -stride + 3, -2 * stride + 2,
+		-3 * stride + 1, -3 * stride, -3 * stride - 1, -2 * stride - 2, -stride - 3, -3, stride - 3, 2 * stride - 2,
+		3 * stride - 1, 3 * stride, 3 * stride + 1, 2 * stride + 2, stride + 3, 3, -stride + 3, -2 * stride + 2, -3 * stride + 1 };
+
 	uint8_t* rawbuf;
 	uint8_t* rowbuf[3];
 	int32_t* cornerbuf[3];
@@ -429,10 +742,6 @@ void _KFAST(const uint8_t* __restrict const data, const int32_t cols, const int3
 
 	int32_t j;
 	for (int32_t i = 3; i < rows - 2; ++i) {
-
-		// ptr points to the first valid offsets in the row but hasn't retrieved it yet
-		const uint8_t* ptr = data + i*stride + 3;
-
 		uint8_t* cur = nullptr;
 		int32_t* corners = nullptr;
 		int32_t num_corners;
@@ -449,16 +758,19 @@ void _KFAST(const uint8_t* __restrict const data, const int32_t cols, const int3
 		}
 
 		if (i < rows - 3) {
-			// for col (3) to (cols - 35)
-			// jumping forward 32 cols at a time and also moving ptr forward 32 cols each time with it
-			// these calls to processCols MUST be inlined for best performance, even if your compiler thinks otherwise
-			for (j = 3; j < cols - 35; j += 32, ptr += 32) {
-				processCols<true, nonmax_suppression>(num_corners, ptr, j, offsets, ushft, t,
-					cols, consec, corners, cur, keypoints, i, start_row);
+			switch (isa) {
+			case KORAL_ISA::AVX512:
+				KFAST_row_AVX512<nonmax_suppression>(data, cols, stride, offsets, threshold, i, start_row, num_corners, corners, cur, keypoints);
+				break;
+			case KORAL_ISA::AVX2:
+				KFAST_row_AVX2<nonmax_suppression>(data, cols, stride, offsets, threshold, i, start_row, num_corners, corners, cur, keypoints);
+				break;
+			case KORAL_ISA::SSE42:
+				KFAST_row_SSE<nonmax_suppression>(data, cols, stride, offsets, threshold, i, start_row, num_corners, corners, cur, keypoints);
+				break;
+			default:
+				KFAST_row_scalar<nonmax_suppression>(data, cols, stride, offsets, threshold, i, start_row, num_corners, corners, cur, keypoints);
 			}
-			// handle last few columns
-			processCols<false, nonmax_suppression>(num_corners, ptr, j, offsets, ushft, t,
-				cols, consec, corners, cur, keypoints, i, start_row);
 		}
 
 		if (nonmax_suppression) {
@@ -480,6 +792,10 @@ void _KFAST(const uint8_t* __restrict const data, const int32_t cols, const int3
 
 			// retrieve previous num_corners
 			num_corners = corners[-1];
+			if (isa == KORAL_ISA::AVX512) {
+				if (num_corners) KFAST_nms_AVX512(last2, last, cur, cols, start_row + i - 1, keypoints);
+				continue;
+			}
 			// for each corner from the previous row
 			for (int32_t k = 0; k < num_corners; ++k) {
 				// corner was at col j
@@ -499,43 +815,71 @@ void _KFAST(const uint8_t* __restrict const data, const int32_t cols, const int3
 	if (nonmax_suppression) _mm_free(rawbuf);
 }
 
+// A horizontal band of the image scanned by one task. Bands overlap by the
+// rows the FAST circle (and non-max suppression) needs, but each band only
+// reports corners in its own rows.
+struct KFAST_Band {
+	int32_t start_row;
+	int32_t rows;
+	bool first;
+	bool last;
+};
+
+// Splits 'rows' into at most 'bands' bands of at least 16 rows each
+inline void KFAST_bands(const int32_t rows, int32_t bands, const bool nonmax_suppression, std::vector<KFAST_Band>& out) {
+	bands = std::max(1, std::min(rows >> 4, bands));
+	out.clear();
+	if (bands == 1) {
+		out.push_back({ 0, rows, true, true });
+		return;
+	}
+
+	const int32_t border = 3 + nonmax_suppression;
+	int32_t row = (rows - 1) / bands + 1;
+	out.push_back({ 0, row + border, true, false });
+	int32_t i = 1;
+	for (; i < bands - 1; ++i) {
+		const int32_t delta = (rows - row - 1) / (bands - i) + 1;
+		out.push_back({ row - border, delta + (border << 1), false, false });
+		row += delta;
+	}
+	out.push_back({ row - border, rows - (row - border), false, true });
+}
+
+template <const bool nonmax_suppression>
+void KFAST_band(const uint8_t* __restrict const data, const int32_t cols, const int32_t stride, const KFAST_Band& band,
+	std::vector<Keypoint>& keypoints, const uint8_t threshold) {
+	const uint8_t* band_data = data + band.start_row * stride;
+	if (band.first && band.last)
+		_KFAST<nonmax_suppression, true, true>(band_data, cols, band.start_row, band.rows, stride, keypoints, threshold);
+	else if (band.first)
+		_KFAST<nonmax_suppression, true, false>(band_data, cols, band.start_row, band.rows, stride, keypoints, threshold);
+	else if (band.last)
+		_KFAST<nonmax_suppression, false, true>(band_data, cols, band.start_row, band.rows, stride, keypoints, threshold);
+	else
+		_KFAST<nonmax_suppression, false, false>(band_data, cols, band.start_row, band.rows, stride, keypoints, threshold);
+}
+
 template <const bool multithreading, const bool nonmax_suppression>
 void KFAST(const uint8_t* __restrict const data, const int32_t cols, const int32_t rows, const int32_t stride,
-        std::vector<Keypoint>& keypoints, const uint8_t threshold) {
-        if (multithreading) {
-                const int32_t hw_concur = std::min(rows >> 4, static_cast<int32_t>(std::thread::hardware_concurrency()));
-                std::vector<std::vector<Keypoint>> thread_kps(hw_concur);
-                std::vector<std::future<void>> fut(hw_concur);
-
-                if (hw_concur <= 1) {
-                        keypoints.clear();
-                        keypoints.reserve(8500);
-                        _KFAST<nonmax_suppression, true, true>(data, cols, 0, rows, stride, keypoints, threshold);
-                }
-                else {
-                        int row = (rows - 1) / hw_concur + 1;
-                        fut[0] = std::async(std::launch::async, _KFAST<nonmax_suppression, true, false>, data, cols, 0, row + (3 + nonmax_suppression), stride, std::ref(thread_kps[0]), threshold);
-                        int i = 1;
-                        for (; i < hw_concur - 1; ++i) {
-                                const int start_row = row - (3 + nonmax_suppression);
-                                const int delta = (rows - row - 1) / (hw_concur - i) + 1;
-                                fut[i] = std::async(std::launch::async, _KFAST<nonmax_suppression, false, false>, data + start_row*stride, cols, start_row, delta + ((3 + nonmax_suppression) << 1), stride, std::ref(thread_kps[i]), threshold);
-                                row += delta;
-                        }
-                        int start_row = row - (3 + nonmax_suppression);
-                        fut[i] = std::async(std::launch::async, _KFAST<nonmax_suppression, false, true>, data + start_row*stride, cols, start_row, rows - start_row, stride, std::ref(thread_kps[i]), threshold);
-                        keypoints.clear();
-                        keypoints.reserve(8500);
-                        for (int j = 0; j <= i; ++j) {
-                                fut[j].wait();
-                                keypoints.insert(keypoints.end(), thread_kps[j].begin(), thread_kps[j].end());
-                        }
-                }
-        }
-        else {
-                keypoints.clear();
-                keypoints.reserve(8500);
-                _KFAST<nonmax_suppression, true, true>(data, cols, 0, rows, stride, keypoints, threshold);
-        }
-}
+	std::vector<Keypoint>& keypoints, const uint8_t threshold) {
+	keypoints.clear();
+	keypoints.reserve(8500);
+	if (!multithreading) {
+		_KFAST<nonmax_suppression, true, true>(data, cols, 0, rows, stride, keypoints, threshold);
+		return;
+	}
 
+	// row bands are run as tasks on the shared pool rather than on freshly spawned threads
+	coloc::ThreadPool& pool = coloc::ThreadPool::instance();
+	std::vector<KFAST_Band> bands;
+	KFAST_bands(rows, static_cast<int32_t>(pool.size()), nonmax_suppression, bands);
+
+	std::vector<std::vector<Keypoint>> band_kps(bands.size());
+	pool.parallelFor(0, bands.size(), [&](size_t band) {
+		KFAST_band<nonmax_suppression>(data, cols, stride, bands[band], band_kps[band], threshold);
+	});
+
+	for (const auto& kps : band_kps)
+		keypoints.insert(keypoints.end(), kps.begin(), kps.end());
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "coloc/colocData.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include <vector>
+
+namespace coloc
+{
+	// Image positions of map landmarks, e.g. the inliers of a localized frame
+	struct Correspondences {
+		std::vector <cv::Point2f> points;
+		std::vector <Vec3> landmarks;
+	};
+
+	// Follows one drone's 2D-3D correspondences from frame to frame with pyramidal Lucas-Kanade
+	// optical flow, so its pose can be computed without detecting and matching every frame.
+	// Tracks are kept only if the flow back from the new frame lands where they started.
+	// The pyramid of the last frame is kept, so every frame's pyramid is built once.
+	class KLTTracker
+	{
+	public:
+		explicit KLTTracker(int winSize = 21, int maxLevel = 3, float maxBackError = 1.0f)
+			: winSize(winSize, winSize), maxLevel(maxLevel), maxBackError(maxBackError)
+		{
+		}
+
+		// Starts again from the correspondences found in 'image', a keyframe
+		void reset(const GrayImage& image, Correspondences correspondences)
+		{
+			tracks = std::move(correspondences);
+			cv::buildOpticalFlowPyramid(wrap(image), previous, winSize, maxLevel);
+			framesSinceKeyframe = 0;
+		}
+
+		void clear()
+		{
+			tracks = Correspondences();
+			previous.clear();
+		}
+
+		bool active() const { return !tracks.points.empty(); }
+
+		// Frames tracked since the last keyframe
+		unsigned int age() const { return framesSinceKeyframe; }
+
+		// Moves the tracks into 'image' and drops the ones lost on the way, returns how many are left
+		size_t track(const GrayImage& image)
+		{
+			if (!active())
+				return 0;
+
+			cv::buildOpticalFlowPyramid(wrap(image), next, winSize, maxLevel);
+			std::vector <cv::Point2f> moved, back;
+			std::vector <uchar> status, backStatus;
+			std::vector <float> error;
+			cv::calcOpticalFlowPyrLK(previous, next, tracks.points, moved, status, error, winSize, maxLevel);
+			cv::calcOpticalFlowPyrLK(next, previous, moved, back, backStatus, error, winSize, maxLevel);
+
+			const cv::Rect2f frame(0.0f, 0.0f, static_cast<float>(image.Width()), static_cast<float>(image.Height()));
+			size_t kept = 0;
+			for (size_t i = 0; i < moved.size(); ++i) {
+				const cv::Point2f d = back[i] - tracks.points[i];
+				if (!status[i] || !backStatus[i] || d.dot(d) > maxBackError * maxBackError || !frame.contains(moved[i]))
+					continue;
+				tracks.points[kept] = moved[i];
+				tracks.landmarks[kept] = tracks.landmarks[i];
+				++kept;
+			}
+			tracks.points.resize(kept);
+			tracks.landmarks.resize(kept);
+
+			std::swap(previous, next);
+			++framesSinceKeyframe;
+			return kept;
+		}
+
+		// Keeps only the tracks at 'inliers', e.g. the PnP inliers
+		void keep(const std::vector <uint32_t>& inliers)
+		{
+			Correspondences kept;
+			kept.points.reserve(inliers.size());
+			kept.landmarks.reserve(inliers.size());
+			for (uint32_t i : inliers) {
+				kept.points.push_back(tracks.points[i]);
+				kept.landmarks.push_back(tracks.landmarks[i]);
+			}
+			tracks = std::move(kept);
+		}
+
+		const Correspondences& correspondences() const { return tracks; }
+
+	private:
+		const cv::Size winSize;
+		const int maxLevel;
+		const float maxBackError;
+
+		Correspondences tracks;
+		std::vector <cv::Mat> previous, next;
+		unsigned int framesSinceKeyframe = 0;
+
+		static cv::Mat wrap(const GrayImage& image)
+		{
+			return cv::Mat(image.Height(), image.Width(), CV_8UC1, const_cast<unsigned char*>(image.data()));
+		}
+	};
+}
@@ -3,6 +3,8 @@
 #include "colocData.hpp"
 #include <opencv2/video/tracking.hpp>
 
+#include <mutex>
+
 namespace coloc
 {
 	class colocFilter
@@ -11,7 +13,8 @@ namespace coloc
 		std::vector <cv::KalmanFilter> droneFilters;
 		std::vector <cv::Mat> droneMeasurements;
 
-		colocFilter(unsigned int& nDrones)
+		// 'logFolder' keeps the gating log of each session apart
+		colocFilter(unsigned int& nDrones, const std::string& logFolder = "") : gatingLogFile(logFolder + "mahalanobis.txt")
 		{
 			for (unsigned int i = 0; i < nDrones; ++i) {
 				cv::Mat measurements(nMeasurements, 1, CV_64F); measurements.setTo(cv::Scalar(0));
@@ -19,11 +22,15 @@ namespace coloc
 				initKalmanFilter(KF, nStates, nMeasurements, nInputs, dt);
 				droneFilters.push_back(KF);
 				droneMeasurements.push_back(measurements);
+				measurementsAvailable.push_back(false);
+				initializing.push_back(true);
 			}
 		}
 
-		void fillMeasurements(cv::Mat &measurements, const Vec3& translation_measured, const Mat3& rotation_measured)
+		void fillMeasurements(int& droneId, const Vec3& translation_measured, const Mat3& rotation_measured)
 		{
+			cv::Mat &measurements = droneMeasurements[droneId];
+
 			// Convert rotation matrix to euler angles
 			cv::Mat measured_eulers(3, 1, CV_64F), rotMatrix;
 
@@ -38,7 +45,7 @@ namespace coloc
 			measurements.at<double>(4) = measured_eulers.at<double>(1);      // pitch
 			measurements.at<double>(5) = measured_eulers.at<double>(2);      // yaw
 
-			measurementsAvailable = true;
+			measurementsAvailable[droneId] = true;
 		}
 
 		void update(int& droneId, Pose3& pose, Cov6& cov, float& rmse)
@@ -58,9 +65,9 @@ namespace coloc
 			droneFilters[droneId].measurementNoiseCov.at<double>(5, 4) = cov[34] * rmse;
 			droneFilters[droneId].measurementNoiseCov.at<double>(5, 5) = cov[35] * rmse;
 
-			if (measurementsAvailable) {
+			if (measurementsAvailable[droneId]) {
 				bool reject = chiSquareGating(droneId, droneMeasurements[droneId], predicted);
-				if (reject && !init) {
+				if (reject && !initializing[droneId]) {
 					estimated = predicted;
 				}
 				else
@@ -72,36 +79,53 @@ namespace coloc
 				estimated = predicted;
 			}
 
+			pose = stateToPose(estimated);
+			measurementsAvailable[droneId] = false;
+			initializing[droneId] = false;
+		}
+
+		// Pose the filter predicts for the drone's next frame, without advancing the filter
+		Pose3 predictedPose(int droneId) const
+		{
+			const cv::KalmanFilter &KF = droneFilters[droneId];
+			cv::Mat predicted = KF.transitionMatrix * KF.statePost;
+			return stateToPose(predicted);
+		}
+
+	private:
+		int nStates = 6;            
+		int nMeasurements = 6;       
+		int nInputs = 0;             
+		double dt = 0.066;   
+
+		// Drones are updated concurrently in parallel intra-MAV mode, so every
+		// per-drone flag lives in its own byte (not std::vector<bool>).
+		std::vector<char> measurementsAvailable;
+		// The first update of each drone is not gated, its filter has no prior yet
+		std::vector<char> initializing;
+		std::string gatingLogFile;
+		std::mutex gatingLogMutex;
+
+		static Pose3 stateToPose(const cv::Mat &state)
+		{
 			Vec3 t;
-			t[0] = estimated.at<double>(0);
-			t[1] = estimated.at<double>(1);
-			t[2] = estimated.at<double>(2);
+			t[0] = state.at<double>(0);
+			t[1] = state.at<double>(1);
+			t[2] = state.at<double>(2);
 
 			cv::Mat eulers_estimated(3, 1, CV_64F);
-			eulers_estimated.at<double>(0) = estimated.at<double>(3);
-			eulers_estimated.at<double>(1) = estimated.at<double>(4);
-			eulers_estimated.at<double>(2) = estimated.at<double>(5);
+			eulers_estimated.at<double>(0) = state.at<double>(3);
+			eulers_estimated.at<double>(1) = state.at<double>(4);
+			eulers_estimated.at<double>(2) = state.at<double>(5);
 
 			cv::Mat Rcv = coloc::Utils::euler2rot(eulers_estimated);
 
 			Mat3 R;
 			cv::cv2eigen(Rcv, R);
 
-			pose = Pose3(R, t);
-			measurementsAvailable = false;
-			
-			if (droneId == 2)
-				init = false;
+			return Pose3(R, t);
 		}
 
-	private:
-		int nStates = 6;            
-		int nMeasurements = 6;       
-		int nInputs = 0;             
-		double dt = 0.066;   
-		bool init = true;
-		bool measurementsAvailable;
-
 		void initKalmanFilter(cv::KalmanFilter &KF, int nStates, int nMeasurements, int nInputs, double dt)
 		{
 			KF.init(nStates, nMeasurements, nInputs, CV_64F);                 // init Kalman Filter
@@ -145,12 +169,15 @@ namespace coloc
 
 			std::cout << dist << std::endl;
 
-			std::ofstream myfile;
-			myfile.open("mahalanobis.txt", std::ios_base::app);
+			{
+				std::lock_guard<std::mutex> lock(gatingLogMutex);
+				std::ofstream myfile;
+				myfile.open(gatingLogFile, std::ios_base::app);
 
-			myfile << droneId << "," << dist << std::endl;
+				myfile << droneId << "," << dist << std::endl;
 
-			myfile.close();
+				myfile.close();
+			}
 
 			if (dist > 10) {
 				std::cout << "Need to reject";
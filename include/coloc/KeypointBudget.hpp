@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace coloc
+{
+	// Where a keypoint is in the full-resolution image and how strong it is
+	struct BudgetPoint {
+		float x;
+		float y;
+		float score;
+	};
+
+	// Keeps at most 'budget' keypoints, spread over a grid x grid layout of the image. Every
+	// cell gets the same quota, and the quota that sparse cells cannot use goes to the others,
+	// so the budget is still filled when features cluster. Within a cell the strongest
+	// keypoints are kept. 'locate' maps a keypoint to its BudgetPoint. Order is preserved.
+	template <typename KP, typename F>
+	void applyKeypointBudget(std::vector<KP>& kps, size_t budget, float width, float height, unsigned int grid, F locate)
+	{
+		if (budget == 0 || kps.size() <= budget)
+			return;
+		grid = std::max(grid, 1u);
+
+		const size_t n = kps.size();
+		std::vector<uint32_t> cells(n);
+		std::vector<float> scores(n);
+		std::vector<uint32_t> counts(grid * grid, 0);
+		for (size_t i = 0; i < n; ++i) {
+			const BudgetPoint p = locate(kps[i]);
+			const int cx = std::min(std::max(static_cast<int>(p.x * grid / width), 0), static_cast<int>(grid) - 1);
+			const int cy = std::min(std::max(static_cast<int>(p.y * grid / height), 0), static_cast<int>(grid) - 1);
+			cells[i] = static_cast<uint32_t>(cy * grid + cx);
+			scores[i] = p.score;
+			++counts[cells[i]];
+		}
+
+		// Largest per-cell quota that fits: every cell keeps min(count, quota)
+		uint32_t quota = 0;
+		size_t kept = 0;
+		for (;;) {
+			size_t next = 0;
+			for (uint32_t count : counts)
+				next += std::min(count, quota + 1);
+			if (next > budget)
+				break;
+			kept = next;
+			++quota;
+		}
+
+		// Rank the keypoints of each cell, strongest first
+		std::vector<uint32_t> order(n);
+		for (size_t i = 0; i < n; ++i)
+			order[i] = static_cast<uint32_t>(i);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return cells[a] != cells[b] ? cells[a] < cells[b] : (scores[a] != scores[b] ? scores[a] > scores[b] : a < b);
+		});
+
+		// Everything ranked below the quota stays, the strongest of rank 'quota' fill the rest
+		std::vector<char> keep(n, 0);
+		std::vector<uint32_t> next;
+		for (size_t i = 0, rank = 0; i < n; ++i) {
+			rank = (i > 0 && cells[order[i]] == cells[order[i - 1]]) ? rank + 1 : 0;
+			if (rank < quota)
+				keep[order[i]] = 1;
+			else if (rank == quota)
+				next.push_back(order[i]);
+		}
+		const size_t fill = std::min(budget - kept, next.size());
+		std::partial_sort(next.begin(), next.begin() + fill, next.end(), [&](uint32_t a, uint32_t b) {
+			return scores[a] != scores[b] ? scores[a] > scores[b] : a < b;
+		});
+		for (size_t i = 0; i < fill; ++i)
+			keep[next[i]] = 1;
+
+		size_t out = 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (keep[i])
+				kps[out++] = kps[i];
+		}
+		kps.erase(kps.begin() + out, kps.end());
+	}
+}
@@ -0,0 +1,161 @@
+/*******************************************************************
+*   LATCH.h
+*   KORAL
+*
+*	CPU port of CLATCH by Kareem Omar (https://github.com/komrad36),
+*	see CLATCH.h for the license.
+*******************************************************************/
+//
+// Computes the same 512-bit LATCH descriptors as the CLATCH CUDA
+// kernel, for machines without an NVIDIA GPU.
+//
+// For each keypoint a 64x64 window, rotated by the keypoint angle,
+// is sampled from its scale level with nearest-neighbor lookups and
+// clamped borders, exactly like the texture fetches of CLATCH. Bit n
+// of the descriptor is set when the 8x8 patch at the anchor of
+// triplet n is closer (sum of squared differences) to the second
+// patch than to the first one.
+//
+// Sample positions use fused multiply-adds where nvcc contracts the
+// CLATCH expressions (its default -fmad=true), so that the rounding to
+// pixels, and with it the descriptor, is bit-identical to the GPU.
+// The patch comparisons are exact integer sums in any order.
+//
+// On hosts with AVX2 (see CPUDispatch.h) the window is fetched with
+// gathers, 8 pixels at a time, and each patch comparison takes 4
+// multiply-adds over two rows.
+// Keypoints are described in parallel on the shared thread pool.
+// The AVX2 gathers read 4 bytes per pixel: every level must stay
+// readable 3 bytes past its last pixel.
+//
+
+#pragma once
+
+#include "CPUDispatch.h"
+#include "Keypoint.h"
+#include "LATCHTriplets.h"
+#include "coloc/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+
+// Sampling window as in CLATCH: 64 rows of 72 bytes, only the first 64 columns are sampled
+constexpr int32_t LATCH_ROI_stride = 72;
+constexpr int32_t LATCH_ROI_size = 64;
+
+inline void LATCH_sampleROI(const uint8_t* const __restrict image, const int32_t width, const int32_t height, const Keypoint& pt, uint8_t* const __restrict ROI) {
+	const float s = sin(pt.angle), c = cos(pt.angle);
+	for (int32_t i = 0; i < LATCH_ROI_size; ++i) {
+		const float y_offset = static_cast<float>(i - 32);
+		for (int32_t k = 0; k < LATCH_ROI_size; ++k) {
+			const float x_offset = static_cast<float>(k - 32);
+			const int32_t x = static_cast<int>((pt.x + fmaf(x_offset, c, -(y_offset*s))) + 0.5f);
+			const int32_t y = static_cast<int>((pt.y + fmaf(x_offset, s, y_offset*c)) + 0.5f);
+			ROI[i * LATCH_ROI_stride + k] = image[std::min(std::max(y, 0), height - 1) * width + std::min(std::max(x, 0), width - 1)];
+		}
+	}
+}
+
+inline void LATCH_describe(const uint8_t* const __restrict ROI, uint32_t* const __restrict desc) {
+	for (int32_t w = 0; w < 16; ++w) {
+		uint32_t bits = 0;
+		for (int32_t b = 0; b < 32; ++b) {
+			const uint16_t* const t = triplets + ((w << 5) + b) * 4;
+			int32_t accum = 0;
+			for (int32_t row = 0; row < 8; ++row) {
+				const uint8_t* const p = ROI + row * LATCH_ROI_stride;
+				for (int32_t col = 0; col < 8; ++col) {
+					const int32_t anchor = p[col + t[1]];
+					const int32_t a = p[col + t[0]] - anchor;
+					const int32_t c = p[col + t[2]] - anchor;
+					accum += a * a - c * c;
+				}
+			}
+			bits |= static_cast<uint32_t>(accum < 0) << b;
+		}
+		desc[w] = bits;
+	}
+}
+
+KORAL_TARGET_AVX2
+inline void LATCH_sampleROI_AVX2(const uint8_t* const __restrict image, const int32_t width, const int32_t height, const Keypoint& pt, uint8_t* const __restrict ROI) {
+	const float s = sin(pt.angle), c = cos(pt.angle);
+	const __m256 vs = _mm256_set1_ps(s), vc = _mm256_set1_ps(c), half = _mm256_set1_ps(0.5f);
+	const __m256 px = _mm256_set1_ps(static_cast<float>(pt.x)), py = _mm256_set1_ps(static_cast<float>(pt.y));
+	const __m256i zero = _mm256_setzero_si256(), max_x = _mm256_set1_epi32(width - 1), max_y = _mm256_set1_epi32(height - 1);
+	const __m256i step = _mm256_set1_epi32(width);
+	// byte 0 of every 32-bit lane into the low 4 bytes of each 128-bit half
+	const __m256i low_bytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	for (int32_t i = 0; i < LATCH_ROI_size; ++i) {
+		const __m256 y_offset = _mm256_set1_ps(static_cast<float>(i - 32));
+		const __m256 ys = _mm256_mul_ps(y_offset, vs), yc = _mm256_mul_ps(y_offset, vc);
+		for (int32_t k = 0; k < LATCH_ROI_size; k += 8) {
+			const __m256 x_offset = _mm256_setr_ps(k - 32.0f, k - 31.0f, k - 30.0f, k - 29.0f, k - 28.0f, k - 27.0f, k - 26.0f, k - 25.0f);
+			__m256i x = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(px, _mm256_fmsub_ps(x_offset, vc, ys)), half));
+			__m256i y = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_add_ps(py, _mm256_fmadd_ps(x_offset, vs, yc)), half));
+			x = _mm256_min_epi32(_mm256_max_epi32(x, zero), max_x);
+			y = _mm256_min_epi32(_mm256_max_epi32(y, zero), max_y);
+			const __m256i pixels = _mm256_shuffle_epi8(_mm256_i32gather_epi32(reinterpret_cast<const int*>(image), _mm256_add_epi32(_mm256_mullo_epi32(y, step), x), 1), low_bytes);
+			const __m128i packed = _mm_unpacklo_epi32(_mm256_castsi256_si128(pixels), _mm256_extracti128_si256(pixels, 1));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(ROI + i * LATCH_ROI_stride + k), packed);
+		}
+	}
+}
+
+// 8 pixels each of two consecutive window rows, widened to 16 bits
+KORAL_TARGET_AVX2
+inline __m256i LATCH_loadRows(const uint8_t* const p) {
+	return _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)),
+		_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + LATCH_ROI_stride))));
+}
+
+KORAL_TARGET_AVX2
+inline void LATCH_describe_AVX2(const uint8_t* const __restrict ROI, uint32_t* const __restrict desc) {
+	uint8_t* const bytes = reinterpret_cast<uint8_t*>(desc);
+	for (int32_t g = 0; g < 64; ++g) {
+		__m256i accum[8];
+		for (int32_t j = 0; j < 8; ++j) {
+			const uint16_t* const t = triplets + ((g << 3) + j) * 4;
+			__m256i sum = _mm256_setzero_si256();
+			for (int32_t row = 0; row < 8; row += 2) {
+				const uint8_t* const p = ROI + row * LATCH_ROI_stride;
+				const __m256i a = LATCH_loadRows(p + t[0]);
+				const __m256i anchor = LATCH_loadRows(p + t[1]);
+				const __m256i c = LATCH_loadRows(p + t[2]);
+				// (a - anchor)^2 - (c - anchor)^2 = (a - c) * (a + c - 2 * anchor)
+				sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_sub_epi16(a, c), _mm256_sub_epi16(_mm256_add_epi16(a, c), _mm256_add_epi16(anchor, anchor))));
+			}
+			accum[j] = sum;
+		}
+		// Horizontal sums of the 8 triplets, in order
+		const __m256i h0 = _mm256_hadd_epi32(_mm256_hadd_epi32(accum[0], accum[1]), _mm256_hadd_epi32(accum[2], accum[3]));
+		const __m256i h1 = _mm256_hadd_epi32(_mm256_hadd_epi32(accum[4], accum[5]), _mm256_hadd_epi32(accum[6], accum[7]));
+		const __m256i total = _mm256_add_epi32(_mm256_permute2x128_si256(h0, h1, 0x20), _mm256_permute2x128_si256(h0, h1, 0x31));
+		bytes[g] = static_cast<uint8_t>(_mm256_movemask_ps(_mm256_castsi256_ps(total)));
+	}
+}
+
+// levels[i], widths[i] and heights[i] describe scale level i; desc receives 8 words per keypoint
+inline void LATCH(const uint8_t* const* levels, const uint32_t* widths, const uint32_t* heights, const Keypoint* const __restrict kps, const int num_kps, uint64_t* const __restrict desc) {
+	constexpr int chunk = 64;
+	const int num_chunks = (num_kps + chunk - 1) / chunk;
+	const bool avx2 = KORAL_isa() >= KORAL_ISA::AVX2;
+	coloc::ThreadPool::instance().parallelFor(0, num_chunks, [&](size_t n) {
+		uint8_t ROI[LATCH_ROI_size * LATCH_ROI_stride];
+		const int end = std::min(num_kps, static_cast<int>(n + 1) * chunk);
+		for (int i = static_cast<int>(n) * chunk; i < end; ++i) {
+			const Keypoint& pt = kps[i];
+			if (avx2) {
+				LATCH_sampleROI_AVX2(levels[pt.scale], widths[pt.scale], heights[pt.scale], pt, ROI);
+				LATCH_describe_AVX2(ROI, reinterpret_cast<uint32_t*>(desc + 8 * i));
+			}
+			else {
+				LATCH_sampleROI(levels[pt.scale], widths[pt.scale], heights[pt.scale], pt, ROI);
+				LATCH_describe(ROI, reinterpret_cast<uint32_t*>(desc + 8 * i));
+			}
+		}
+	});
+}
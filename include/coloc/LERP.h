@@ -0,0 +1,105 @@
+/*******************************************************************
+*   LERP.h
+*   KORAL
+*
+*	CPU port of CUDALERP by Kareem Omar (https://github.com/komrad36),
+*	see KORAL.h for the license.
+*******************************************************************/
+//
+// Bilinear downscaling of a grayscale image by (gxs, gys), with
+// the same sample positions, clamped borders and rounding as the
+// CUDALERP kernel, for machines without an NVIDIA GPU.
+//
+// On hosts with AVX2 (see CPUDispatch.h), 8 output pixels are interpolated at a time from gathered
+// neighbors, with the same float operations as the scalar version
+// (results can differ by one gray level where the compiler contracts
+// the scalar version into FMAs). The gathers read 4 bytes per pixel:
+// the input must stay readable 3 bytes past its last pixel.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+
+#include "CPUDispatch.h"
+
+inline void LERP_scalar(const uint8_t* const __restrict image, const int32_t width, const int32_t height, const float gxs, const float gys, uint8_t* __restrict const out, const uint32_t neww, const uint32_t newh) {
+	for (uint32_t y = 0; y < newh; ++y) {
+		const float fy = (y + 0.5f)*gys - 0.5f;
+		const float wt_y = fy - floor(fy);
+		const float invwt_y = 1.0f - wt_y;
+		const int32_t y0 = std::min(std::max(static_cast<int32_t>(floor(fy)), 0), height - 1);
+		const int32_t y1 = std::min(y0 + 1, height - 1);
+		const uint8_t* const row0 = image + y0 * width;
+		const uint8_t* const row1 = image + y1 * width;
+		for (uint32_t x = 0; x < neww; ++x) {
+			const float fx = (x + 0.5f)*gxs - 0.5f;
+			const float wt_x = fx - floor(fx);
+			const float invwt_x = 1.0f - wt_x;
+			const int32_t x0 = std::min(std::max(static_cast<int32_t>(floor(fx)), 0), width - 1);
+			const int32_t x1 = std::min(x0 + 1, width - 1);
+			const float xa = invwt_x*row0[x0] + wt_x*row0[x1];
+			const float xb = invwt_x*row1[x0] + wt_x*row1[x1];
+			out[y*neww + x] = static_cast<uint8_t>(invwt_y*xa + wt_y*xb + 0.5f);
+		}
+	}
+}
+
+KORAL_TARGET_AVX2
+inline void LERP_AVX2(const uint8_t* const __restrict image, const int32_t width, const int32_t height, const float gxs, const float gys, uint8_t* __restrict const out, const uint32_t neww, const uint32_t newh) {
+	const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), vgxs = _mm256_set1_ps(gxs);
+	const __m256i zero = _mm256_setzero_si256(), max_x = _mm256_set1_epi32(width - 1), mask = _mm256_set1_epi32(0xFF);
+	const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const uint32_t vec_w = neww & ~7u;
+	for (uint32_t y = 0; y < newh; ++y) {
+		const float fy = (y + 0.5f)*gys - 0.5f;
+		const float wt_y = fy - floor(fy);
+		const __m256 vwt_y = _mm256_set1_ps(wt_y), vinvwt_y = _mm256_set1_ps(1.0f - wt_y);
+		const int32_t y0 = std::min(std::max(static_cast<int32_t>(floor(fy)), 0), height - 1);
+		const int32_t y1 = std::min(y0 + 1, height - 1);
+		const int* const row0 = reinterpret_cast<const int*>(image + y0 * width);
+		const int* const row1 = reinterpret_cast<const int*>(image + y1 * width);
+		uint8_t* const out_row = out + y*neww;
+		for (uint32_t x = 0; x < vec_w; x += 8) {
+			const __m256 fx = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lane), half), vgxs), half);
+			const __m256 floor_x = _mm256_floor_ps(fx);
+			const __m256 wt_x = _mm256_sub_ps(fx, floor_x);
+			const __m256 invwt_x = _mm256_sub_ps(one, wt_x);
+			const __m256i x0 = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(floor_x), zero), max_x);
+			const __m256i x1 = _mm256_min_epi32(_mm256_add_epi32(x0, _mm256_set1_epi32(1)), max_x);
+			const __m256 p00 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_i32gather_epi32(row0, x0, 1), mask));
+			const __m256 p01 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_i32gather_epi32(row0, x1, 1), mask));
+			const __m256 p10 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_i32gather_epi32(row1, x0, 1), mask));
+			const __m256 p11 = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_i32gather_epi32(row1, x1, 1), mask));
+			const __m256 xa = _mm256_add_ps(_mm256_mul_ps(invwt_x, p00), _mm256_mul_ps(wt_x, p01));
+			const __m256 xb = _mm256_add_ps(_mm256_mul_ps(invwt_x, p10), _mm256_mul_ps(wt_x, p11));
+			const __m256 res = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vinvwt_y, xa), _mm256_mul_ps(vwt_y, xb)), half);
+			const __m256i res_i = _mm256_cvttps_epi32(res);
+			const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(res_i), _mm256_extracti128_si256(res_i, 1));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out_row + x), _mm_packus_epi16(words, words));
+		}
+		const float invwt_y = 1.0f - wt_y;
+		const uint8_t* const r0 = image + y0 * width;
+		const uint8_t* const r1 = image + y1 * width;
+		for (uint32_t x = vec_w; x < neww; ++x) {
+			const float fx = (x + 0.5f)*gxs - 0.5f;
+			const float wt_x = fx - floor(fx);
+			const float invwt_x = 1.0f - wt_x;
+			const int32_t x0 = std::min(std::max(static_cast<int32_t>(floor(fx)), 0), width - 1);
+			const int32_t x1 = std::min(x0 + 1, width - 1);
+			const float xa = invwt_x*r0[x0] + wt_x*r0[x1];
+			const float xb = invwt_x*r1[x0] + wt_x*r1[x1];
+			out_row[x] = static_cast<uint8_t>(invwt_y*xa + wt_y*xb + 0.5f);
+		}
+	}
+}
+
+inline void LERP(const uint8_t* const __restrict image, const int32_t width, const int32_t height, const float gxs, const float gys, uint8_t* __restrict const out, const uint32_t neww, const uint32_t newh) {
+	if (KORAL_isa() >= KORAL_ISA::AVX2)
+		LERP_AVX2(image, width, height, gxs, gys, out, neww, newh);
+	else
+		LERP_scalar(image, width, height, gxs, gys, out, neww, newh);
+}
@@ -33,10 +33,14 @@ namespace coloc
 
 		std::unique_ptr<features::Regions> regionsCurrent;
 		bool localizeImage(int&, Pose3&, colocData&, Cov6&, float&, IndMatches&, std::vector<uint32_t>&);
-		bool setupTracks(cameras::Pinhole_Intrinsic_Radial_K3* cam, colocData &data, const features::Regions & queryRegions, IndMatches &trackedFeatures, Image_Localizer_Match_Data * trackPtr);
+		bool localizeImage(int&, Pose3&, const colocData&, const features::Regions&, Cov6&, float&, IndMatches&, std::vector<uint32_t>&);
+		bool localizePoints(int&, Pose3&, const std::vector<cv::Point2f>&, const std::vector<Vec3>&, Cov6&, float&, std::vector<uint32_t>&);
+		bool setupTracks(cameras::Pinhole_Intrinsic_Radial_K3* cam, const colocData &data, const features::Regions & queryRegions, IndMatches &trackedFeatures, Image_Localizer_Match_Data * trackPtr);
 		bool refine(int&, Pose3&, Image_Localizer_Match_Data&, Cov6&, float&);
 
 	private:
+		bool localize(int&, Pose3&, cameras::Pinhole_Intrinsic_Radial_K3&, Image_Localizer_Match_Data&, Cov6&, float&, std::vector<uint32_t>&);
+
 		std::unique_ptr<features::Image_describer> image_describer;
 		EMatcherType matchingType;
 		std::pair <int, int> *imageSize;
@@ -56,7 +60,7 @@ namespace coloc
 		std::vector<IndexT> mapDescIdx;
 	};
 
-	bool Localizer::setupTracks(cameras::Pinhole_Intrinsic_Radial_K3* cam, colocData &data, const features::Regions & queryRegions, IndMatches &trackedFeatures, Image_Localizer_Match_Data * trackPtr)
+	bool Localizer::setupTracks(cameras::Pinhole_Intrinsic_Radial_K3* cam, const colocData &data, const features::Regions & queryRegions, IndMatches &trackedFeatures, Image_Localizer_Match_Data * trackPtr)
 	{
 		trackPtr->pt3D.resize(3, trackedFeatures.size());
 		trackPtr->pt2D.resize(2, trackedFeatures.size());
@@ -75,6 +79,11 @@ namespace coloc
 	}
 
 	bool Localizer::localizeImage(int& idx, Pose3& pose, colocData &data, Cov6 &covariance, float& rmse, IndMatches &trackedFeatures, std::vector<uint32_t>& inliers)
+	{
+		return localizeImage(idx, pose, data, *data.regions.at(idx).get(), covariance, rmse, trackedFeatures, inliers);
+	}
+
+	bool Localizer::localizeImage(int& idx, Pose3& pose, const colocData &data, const features::Regions &queryRegions, Cov6 &covariance, float& rmse, IndMatches &trackedFeatures, std::vector<uint32_t>& inliers)
 	{
 		using namespace openMVG::features;
 		openMVG::cameras::Pinhole_Intrinsic_Radial_K3 cam(imageSize->first, imageSize->second, (*K)[idx](0, 0), (*K)[idx](0, 2), (*K)[idx](1, 2), (*dist)[idx](0), (*dist)[idx](1), (*dist)[idx](2));
@@ -85,26 +94,51 @@ namespace coloc
 
 		Image_Localizer_Match_Data trackData;
 
-		if (setupTracks(&cam, data, *data.regions.at(idx).get(), trackedFeatures, &matching_data) == EXIT_FAILURE) {
+		if (setupTracks(&cam, data, queryRegions, trackedFeatures, &matching_data) == EXIT_FAILURE) {
 			std::cout << "Failure while setting up 2D-3D correspondences" << std::endl;
 			return EXIT_FAILURE;
 		}
-		else {
-			bool localizationStatus = SfM_Localizer::Localize(resection::SolverType::P3P_KE_CVPR17, *imageSize, &cam, matching_data, pose);
-			if (!localizationStatus) {
-				std::cout << "Localization unsuccessful" << std::endl;
-				return EXIT_FAILURE;
-			}
-			else {
-				std::cout << "Localization successful" << std::endl;
-				inliers = matching_data.vec_inliers;
-				if (!this->refine(idx, pose, matching_data, covariance, rmse))
-					std::cerr << "Refining pose for image failed." << std::endl;
-
-				return EXIT_SUCCESS;
-			}
+		else
+			return localize(idx, pose, cam, matching_data, covariance, rmse, inliers);
+
+	}
+
+	// Localizes from correspondences that are already known, e.g. tracked with optical flow;
+	// 'points' are distorted pixel positions of the landmarks at 'landmarks'
+	bool Localizer::localizePoints(int& idx, Pose3& pose, const std::vector<cv::Point2f>& points, const std::vector<Vec3>& landmarks, Cov6 &covariance, float& rmse, std::vector<uint32_t>& inliers)
+	{
+		openMVG::cameras::Pinhole_Intrinsic_Radial_K3 cam(imageSize->first, imageSize->second, (*K)[idx](0, 0), (*K)[idx](0, 2), (*K)[idx](1, 2), (*dist)[idx](0), (*dist)[idx](1), (*dist)[idx](2));
+
+		Image_Localizer_Match_Data matching_data;
+		matching_data.error_max = std::numeric_limits<double>::infinity();
+		matching_data.max_iteration = 256;
+		matching_data.pt3D.resize(3, landmarks.size());
+		matching_data.pt2D.resize(2, points.size());
+		for (size_t i = 0; i < points.size(); ++i) {
+			matching_data.pt3D.col(i) = landmarks[i];
+			matching_data.pt2D.col(i) = Vec2(points[i].x, points[i].y);
+			if (cam.have_disto())
+				matching_data.pt2D.col(i) = cam.get_ud_pixel(matching_data.pt2D.col(i));
 		}
 
+		return localize(idx, pose, cam, matching_data, covariance, rmse, inliers);
+	}
+
+	bool Localizer::localize(int& idx, Pose3& pose, cameras::Pinhole_Intrinsic_Radial_K3& cam, Image_Localizer_Match_Data& matching_data, Cov6 &covariance, float& rmse, std::vector<uint32_t>& inliers)
+	{
+		bool localizationStatus = SfM_Localizer::Localize(resection::SolverType::P3P_KE_CVPR17, *imageSize, &cam, matching_data, pose);
+		if (!localizationStatus) {
+			std::cout << "Localization unsuccessful" << std::endl;
+			return EXIT_FAILURE;
+		}
+		else {
+			std::cout << "Localization successful" << std::endl;
+			inliers = matching_data.vec_inliers;
+			if (!this->refine(idx, pose, matching_data, covariance, rmse))
+				std::cerr << "Refining pose for image failed." << std::endl;
+
+			return EXIT_SUCCESS;
+		}
 	}
 
 	bool Localizer::refine(int &idx, Pose3 &pose, Image_Localizer_Match_Data& matchData, Cov6 &poseCovariance, float& rmse)
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "coloc/FeatureAngle.h"
+#include "coloc/KFAST.h"
+#include "coloc/Keypoint.h"
+#include "coloc/ThreadPool.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace coloc
+{
+	// Runs KFAST and featureAngle on every pyramid level at once. Each level is cut into row
+	// bands in proportion to its area, and all level x band tasks go to the pool together, so
+	// the small levels fill in around the large ones instead of the pool ramping up and down
+	// once per level. Keypoints come out in the same order as a level-by-level scan.
+	inline void detectPyramid(const uint8_t* const* images, const uint32_t* widths, const uint32_t* heights, uint8_t numLevels,
+		uint8_t thresh, std::vector<Keypoint>& kps)
+	{
+		struct Task {
+			uint8_t level;
+			KFAST_Band band;
+		};
+
+		ThreadPool& pool = ThreadPool::instance();
+		double totalArea = 0.0;
+		for (uint8_t i = 0; i < numLevels; ++i)
+			totalArea += static_cast<double>(widths[i]) * heights[i];
+
+		// A few tasks per thread keep the pool balanced when the bands finish unevenly
+		const double bandsPerPixel = 4.0 * pool.size() / totalArea;
+		std::vector<Task> tasks;
+		std::vector<KFAST_Band> bands;
+		for (uint8_t i = 0; i < numLevels; ++i) {
+			const int32_t n = static_cast<int32_t>(bandsPerPixel * widths[i] * heights[i] + 0.5);
+			KFAST_bands(static_cast<int32_t>(heights[i]), n, true, bands);
+			for (const KFAST_Band& band : bands)
+				tasks.push_back({ i, band });
+		}
+
+		std::vector<std::vector<Keypoint>> taskKps(tasks.size());
+		pool.parallelFor(0, tasks.size(), [&](size_t t) {
+			const uint8_t level = tasks[t].level;
+			std::vector<Keypoint>& local = taskKps[t];
+			KFAST_band<true>(images[level], widths[level], widths[level], tasks[t].band, local, thresh);
+			for (auto& kp : local) {
+				kp.scale = level;
+				kp.angle = featureAngle(images[level], kp.x, kp.y, static_cast<int>(widths[level]));
+			}
+		});
+
+		size_t total = 0;
+		for (const auto& local : taskKps)
+			total += local.size();
+		kps.clear();
+		kps.reserve(total);
+		for (const auto& local : taskKps)
+			kps.insert(kps.end(), local.begin(), local.end());
+	}
+}
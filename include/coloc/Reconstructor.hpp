@@ -43,7 +43,7 @@ namespace coloc
                   currentFolder(&params.imageFolder)
         {	}
 
-        void reconstructScene(bool inter, colocData& data, std::vector <Pose3>, float, bool);
+        bool reconstructScene(bool inter, colocData& data, std::vector <Pose3>, float, bool);
 		void Reconstructor::interReconstruct(int sourceId, int destId, colocData& data);
 
     private:
@@ -99,7 +99,8 @@ namespace coloc
 		std::cout << "Done." << std::endl;
 	}
 
-    void Reconstructor::reconstructScene(bool inter, colocData& data, std::vector <Pose3> poses, float scale = 1.0, bool Adjust = false)
+    // Returns EXIT_FAILURE if there are no matches to start from or no landmark was triangulated
+    bool Reconstructor::reconstructScene(bool inter, colocData& data, std::vector <Pose3> poses, float scale = 1.0, bool Adjust = false)
     {
         this->regionsRCT = &data.regions;
         this->matchesRCT = &data.geometricMatches;
@@ -116,6 +117,10 @@ namespace coloc
 				seedPair = currentPair;
 			}
 		}
+		if (maxMatches == 0) {
+			std::cout << "No matches to reconstruct the scene from" << std::endl;
+			return EXIT_FAILURE;
+		}
 
 		if (inter) {
 			this->scene = &data.tempScene;
@@ -145,7 +150,7 @@ namespace coloc
         triangulatePoints(seedPair, origin, scale);
         std::cout << "Done." << std::endl;
 
-		std::string initialMap = "initial.ply";
+		std::string initialMap = *currentFolder + "initial.ply";
 		saveSceneData(this->scene, initialMap);
         const Optimize_Options ba_refine_options
                 (cameras::Intrinsic_Parameter_Type::NONE, Extrinsic_Parameter_Type::ADJUST_ALL, Structure_Parameter_Type::ADJUST_ALL);
@@ -153,7 +158,7 @@ namespace coloc
 		for (auto resectionId : resectionList)
 			resectionCamera(resectionId);
 
-		std::string refinedMap = "refined.ply";
+		std::string refinedMap = *currentFolder + "refined.ply";
         std::cout << "Refining scene...";
         float rmse;
         Cov6 cov;
@@ -161,6 +166,7 @@ namespace coloc
             refiner.refinePose(*scene, ba_refine_options, rmse, cov);
         std::cout << "Done." << std::endl;
         saveSceneData(this->scene, refinedMap);
+        return scene->GetLandmarks().empty() ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 
     void Reconstructor::initializeTracks(Pair& viewPair)
@@ -416,7 +422,7 @@ namespace coloc
 
     bool Reconstructor::saveSceneData(Scene* scene, std::string& fileName)
     {
-        if (openMVG::sfm::Save(*scene, stlplus::create_filespec(*currentFolder, fileName), ESfM_Data(ALL)))
+        if (openMVG::sfm::Save(*scene, fileName, ESfM_Data(ALL)))
             return EXIT_SUCCESS;
         else
             return EXIT_FAILURE;
@@ -3,6 +3,7 @@
 //
 #pragma once
 #include "coloc/colocData.hpp"
+#include "coloc/ThreadPool.hpp"
 
 #include "third_party/ceres/problem.h"
 #include "third_party/ceres/solver.h"
@@ -34,7 +35,8 @@ namespace coloc
         struct CeresOptions
         {
             bool bVerbose_ = true;
-            unsigned int nb_threads_ = 4;
+            // 0: the calling thread and the pool threads idle at the time, 1 while the pool is busy
+            unsigned int nb_threads_ = 0;
             bool bCeres_summary_ = false;
             int linear_solver_type_ = ceres::SPARSE_SCHUR;
             int preconditioner_type_ = ceres::JACOBI;
@@ -162,8 +164,11 @@ namespace coloc
         ceresConfig.sparse_linear_algebra_library_type = static_cast<ceres::SparseLinearAlgebraLibraryType>(ceresOptions.sparse_linear_algebra_library_type_);
         ceresConfig.minimizer_progress_to_stdout = ceresOptions.bVerbose_;
         ceresConfig.logging_type = ceres::SILENT;
-        ceresConfig.num_threads = ceresOptions.nb_threads_;
-        ceresConfig.num_linear_solver_threads = ceresOptions.nb_threads_;
+        unsigned int nbThreads = ceresOptions.nb_threads_;
+        if (nbThreads == 0)
+            nbThreads = ThreadPool::instance().availableThreads();
+        ceresConfig.num_threads = nbThreads;
+        ceresConfig.num_linear_solver_threads = nbThreads;
         ceresConfig.function_tolerance = 1e-8;
         ceresConfig.gradient_tolerance = 1e-8;
         ceresConfig.parameter_tolerance = 1e-8;
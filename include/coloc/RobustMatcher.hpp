@@ -4,6 +4,7 @@
 
 #include "colocParams.hpp"
 #include "colocData.hpp"
+#include "ThreadPool.hpp"
 
 #include "openMVG/multiview/motion_from_essential.hpp"
 #include "opencv2/calib3d.hpp"
@@ -238,7 +239,7 @@ namespace coloc
 			return EXIT_SUCCESS;
 		}
 
-		bool matchMaps(std::unique_ptr<features::AKAZE_Binary_Regions> &scene1, std::unique_ptr<features::AKAZE_Binary_Regions> &scene2, std::vector<IndMatch> &commonFeatures, Vec3& poseDiff, Mat3& rotDiff)
+		bool matchMaps(const std::unique_ptr<features::AKAZE_Binary_Regions> &scene1, const std::unique_ptr<features::AKAZE_Binary_Regions> &scene2, std::vector<IndMatch> &commonFeatures, Vec3& poseDiff, Mat3& rotDiff)
 		{
 			std::vector <IndMatch> putativeMatches, filteredMatches;
 
@@ -331,7 +332,7 @@ namespace coloc
 			std::ofstream myfile;
 
 			std::vector <double> epipolarLineDeviations;
-			myfile.open("guidedmatches2.txt");
+			myfile.open(params->imageFolder + "guidedmatches2.txt");
 			for (size_t k = 0; k < putativeMatches.size(); ++k) {
 				Vec3 f1, f2;
 				f1 << xL(0, k), xL(1, k), 1;
@@ -377,7 +378,7 @@ namespace coloc
 			const PointFeatures featI = regions.at(I)->GetRegionsPositions();
 			const PointFeatures featJ = regions.at(J)->GetRegionsPositions();
 
-			std::vector <IndMatch> pairMatches = putativeMatches[current_pair];
+			const std::vector <IndMatch>& pairMatches = putativeMatches.at(current_pair);
 			Mat xL(2, pairMatches.size());
 			Mat xR(2, pairMatches.size());
 					
@@ -454,12 +455,20 @@ namespace coloc
 
 		void filterMatches(FeatureMap& regions, PairWiseMatches& putativeMatches, PairWiseMatches& geometricMatches, InterPoseMap& relativePoses)
 		{
-			for (const auto matchedPair : putativeMatches) {
-				Pair currentPair = matchedPair.first;
-				std::vector <IndMatch> pairMatches = putativeMatches[currentPair];
-				RelativePose_Info relativePose;
-				
-				bool status = computeRelativePose(relativePose, matchedPair.first, regions, putativeMatches);
+			std::vector <Pair> pairs;
+			for (const auto& matchedPair : putativeMatches)
+				pairs.push_back(matchedPair.first);
+
+			// RANSAC for every pair runs as a pool task; the maps are only written below
+			std::vector <RelativePose_Info> pairPoses(pairs.size());
+			ThreadPool::instance().parallelFor(0, pairs.size(), [&](size_t i) {
+				computeRelativePose(pairPoses[i], pairs[i], regions, putativeMatches);
+			});
+
+			for (size_t i = 0; i < pairs.size(); ++i) {
+				Pair currentPair = pairs[i];
+				const std::vector <IndMatch>& pairMatches = putativeMatches.at(currentPair);
+				RelativePose_Info& relativePose = pairPoses[i];
 
 				std::vector <IndMatch> vec_geometricMatches;
 				for (int ic = 0; ic < relativePose.vec_inliers.size(); ++ic)
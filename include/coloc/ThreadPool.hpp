@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef OPENMVG_USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace coloc
+{
+	// Process-wide work-stealing pool shared by every stage (KFAST row bands, pair matching,
+	// RANSAC, per-drone localization), so that nested parallel work shares one set of threads
+	// instead of each stage spawning its own. Each worker owns a task deque: it pops its newest
+	// task first and steals the oldest tasks of other workers when it runs out. Threads waiting
+	// in parallelFor() run queued tasks meanwhile, so nesting cannot deadlock.
+	class ThreadPool
+	{
+	public:
+		// Total number of threads used for computation, including the thread that waits for
+		// the results; 0 uses every hardware thread. Only effective before the first instance().
+		// Every session calls it, possibly concurrently, so the setting is atomic.
+		static void configure(unsigned int threads)
+		{
+			configuredThreads().store(threads);
+		}
+
+		static ThreadPool& instance()
+		{
+			static ThreadPool pool(configuredThreads().load());
+			return pool;
+		}
+
+		unsigned int size() const
+		{
+			return static_cast<unsigned int>(queues.size()) + 1;
+		}
+
+		// Threads a library that starts its own (Ceres, OpenMP) should use from the calling thread:
+		// the caller itself and the pool threads that are idle right now. It is 1 whenever the pool
+		// is fully busy, whether the caller is a worker, waits in parallelFor() or is a background thread.
+		unsigned int availableThreads() const
+		{
+			const unsigned int others = busy - (busyDepth() > 0 ? 1u : 0u);
+			return std::max(1u, size() - std::min(others, size()));
+		}
+
+		template <typename F>
+		std::future<typename std::result_of<F()>::type> submit(F f)
+		{
+			typedef typename std::result_of<F()>::type R;
+			auto task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+			std::future<R> result = task->get_future();
+			if (queues.empty())
+				(*task)();
+			else
+				push([task]() { (*task)(); });
+			return result;
+		}
+
+		// Calls f(i) for every i in [begin, end) and returns once all calls are done
+		template <typename F>
+		void parallelFor(size_t begin, size_t end, F f)
+		{
+			if (begin >= end)
+				return;
+
+			struct Group {
+				std::atomic<size_t> remaining;
+				std::mutex mutex;
+				std::condition_variable done;
+			};
+			auto group = std::make_shared<Group>();
+			group->remaining = end - begin;
+			Busy busyCaller(*this);
+
+			// The calling thread takes the first index itself
+			for (size_t i = begin + 1; i < end; ++i) {
+				push([group, &f, i]() {
+					f(i);
+					if (--group->remaining == 0) {
+						std::lock_guard<std::mutex> lock(group->mutex);
+						group->done.notify_all();
+					}
+				});
+			}
+			f(begin);
+			--group->remaining;
+
+			while (group->remaining > 0) {
+				if (runPendingTask())
+					continue;
+				std::unique_lock<std::mutex> lock(group->mutex);
+				group->done.wait_for(lock, std::chrono::microseconds(500), [&group]() { return group->remaining == 0; });
+			}
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stop = true;
+			}
+			wake.notify_all();
+			for (auto& worker : workers)
+				worker.join();
+		}
+
+	private:
+		struct TaskQueue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		std::vector<std::unique_ptr<TaskQueue>> queues;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> pending{ 0 };
+		std::atomic<size_t> nextQueue{ 0 };
+		// Threads running a task or waiting in parallelFor()
+		std::atomic<unsigned int> busy{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		bool stop = false;
+
+		explicit ThreadPool(unsigned int threads)
+		{
+			if (threads == 0)
+				threads = std::max(1u, std::thread::hardware_concurrency());
+
+			for (unsigned int i = 0; i + 1 < threads; ++i)
+				queues.emplace_back(new TaskQueue);
+			for (unsigned int i = 0; i + 1 < threads; ++i)
+				workers.emplace_back([this, i]() { workerLoop(static_cast<int>(i)); });
+		}
+
+		static std::atomic<unsigned int>& configuredThreads()
+		{
+			static std::atomic<unsigned int> threads{ 0 };
+			return threads;
+		}
+
+		static int& workerIndex()
+		{
+			static thread_local int index = -1;
+			return index;
+		}
+
+		static int& busyDepth()
+		{
+			static thread_local int depth = 0;
+			return depth;
+		}
+
+		// Counts the thread as busy while it runs pool work, once however deeply nested. openMVG's
+		// OpenMP loops run on one thread meanwhile, as on the workers.
+		struct Busy {
+			ThreadPool& pool;
+			const bool outer;
+#ifdef OPENMVG_USE_OPENMP
+			int ompThreads = 0;
+#endif
+
+			explicit Busy(ThreadPool& pool) : pool(pool), outer(busyDepth()++ == 0)
+			{
+				if (!outer)
+					return;
+				pool.busy++;
+#ifdef OPENMVG_USE_OPENMP
+				ompThreads = omp_get_max_threads();
+				omp_set_num_threads(1);
+#endif
+			}
+
+			~Busy()
+			{
+				--busyDepth();
+				if (!outer)
+					return;
+				pool.busy--;
+#ifdef OPENMVG_USE_OPENMP
+				omp_set_num_threads(ompThreads);
+#endif
+			}
+		};
+
+		// Workers add to their own deque, other threads spread tasks round-robin
+		void push(std::function<void()> task)
+		{
+			if (queues.empty()) {
+				task();
+				return;
+			}
+
+			const int own = workerIndex();
+			TaskQueue& queue = *queues[own >= 0 ? own : nextQueue++ % queues.size()];
+			// Counted before it is queued so that 'pending' never drops below zero
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				pending++;
+			}
+			{
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.tasks.push_back(std::move(task));
+			}
+			wake.notify_one();
+		}
+
+		bool runPendingTask()
+		{
+			std::function<void()> task;
+			const int own = workerIndex();
+			const size_t n = queues.size();
+			const size_t first = own >= 0 ? own : 0;
+
+			for (size_t k = 0; k < n && !task; ++k) {
+				const size_t q = (first + k) % n;
+				TaskQueue& queue = *queues[q];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (queue.tasks.empty())
+					continue;
+				if (static_cast<int>(q) == own) {
+					task = std::move(queue.tasks.back());
+					queue.tasks.pop_back();
+				}
+				else {
+					task = std::move(queue.tasks.front());
+					queue.tasks.pop_front();
+				}
+			}
+			if (!task)
+				return false;
+
+			pending--;
+			Busy running(*this);
+			task();
+			return true;
+		}
+
+		void workerLoop(int index)
+		{
+			workerIndex() = index;
+#ifdef OPENMVG_USE_OPENMP
+			// openMVG's OpenMP loops run inside pool tasks; the pool already provides the parallelism
+			omp_set_num_threads(1);
+#endif
+			while (true) {
+				if (runPendingTask())
+					continue;
+
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				wake.wait(lock, [this]() { return stop || pending > 0; });
+				if (stop && pending == 0)
+					return;
+			}
+		}
+	};
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+namespace coloc
+{
+	// Adapts a detector threshold from frame to frame so that one drone's keypoint count stays
+	// near a target. Fewer keypoints lower the threshold, more raise it, by a multiplicative step.
+	// How strongly the count reacts to the threshold depends on the scene and on the threshold
+	// itself, so the step is a damped secant step on log(count) over log(threshold), measured
+	// on the last two frames.
+	//
+	// Hysteresis: the threshold starts moving only once the count leaves the outer band around
+	// the target, and keeps moving until the count is back within the inner band. Counts that
+	// wander inside the outer band leave it alone, so the count does not oscillate with scene noise.
+	class ThresholdController
+	{
+	public:
+		ThresholdController(float initial, float minValue, float maxValue, unsigned int target,
+			float outerBand = 0.3f, float innerBand = 0.1f, float damping = 0.7f)
+			: current(std::min(std::max(initial, minValue), maxValue)), minValue(minValue), maxValue(maxValue), target(target),
+			outerBand(outerBand), innerBand(innerBand), damping(damping)
+		{
+		}
+
+		float value() const { return current; }
+
+		// Feeds the number of keypoints detected with value(), returns the threshold for the next frame
+		float update(size_t count)
+		{
+			if (target == 0)
+				return current;
+
+			const float logCount = std::log(static_cast<float>(std::max<size_t>(count, 1)));
+			const float logValue = std::log(current);
+			const float miss = std::fabs(std::exp(logCount) / target - 1.0f);
+			if (!adjusting && miss > outerBand)
+				adjusting = true;
+			else if (adjusting && miss <= innerBand)
+				adjusting = false;
+
+			if (adjusting) {
+				// Slope of log(count) over log(threshold), negative for any detector
+				float slope = -2.0f;
+				if (havePrevious && std::fabs(logValue - prevLogValue) > 1e-3f)
+					slope = std::min(std::max((logCount - prevLogCount) / (logValue - prevLogValue), -10.0f), -0.2f);
+
+				// At most halve or double per frame
+				const float step = std::min(std::max(-damping * (logCount - std::log(static_cast<float>(target))) / slope, -0.693f), 0.693f);
+				current = std::min(std::max(current * std::exp(step), minValue), maxValue);
+			}
+
+			prevLogCount = logCount;
+			prevLogValue = logValue;
+			havePrevious = true;
+			return current;
+		}
+
+	private:
+		float current;
+		const float minValue;
+		const float maxValue;
+		const unsigned int target;
+		const float outerBand;
+		const float innerBand;
+		const float damping;
+		bool adjusting = false;
+		// The last frame, for the slope estimate
+		bool havePrevious = false;
+		float prevLogCount = 0.0f;
+		float prevLogValue = 0.0f;
+	};
+
+	// One ThresholdController per drone, created on first use. Each controller must only be
+	// used by the detection of its own drone.
+	class DroneThresholds
+	{
+	public:
+		DroneThresholds(float initial, float minValue, float maxValue, unsigned int target)
+			: initial(initial), minValue(minValue), maxValue(maxValue), target(target)
+		{
+		}
+
+		ThresholdController& operator[](unsigned int droneId)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = controllers.find(droneId);
+			if (it == controllers.end())
+				it = controllers.emplace(droneId, ThresholdController(initial, minValue, maxValue, target)).first;
+			return it->second;
+		}
+
+	private:
+		const float initial;
+		const float minValue;
+		const float maxValue;
+		const unsigned int target;
+		std::map<unsigned int, ThresholdController> controllers;
+		std::mutex mutex;
+	};
+}
@@ -3,6 +3,7 @@
 #include "coloc/colocData.hpp"
 #include "coloc/colocParams.hpp"
 #include "coloc/CPUDetector.hpp"
+#include "coloc/CPUKoralDetector.hpp"
 #include "coloc/GPUDetector.hpp"
 #include "coloc/CPUMatcher.hpp"
 #include "coloc/GPUMatcher.hpp"
@@ -15,11 +16,20 @@
 #include "coloc/InterfaceROS.hpp"
 #include "coloc/logUtils.hpp"
 #include "coloc/KalmanFilter.hpp"
+#include "coloc/KLTTracker.hpp"
 #include "coloc/CovIntersection.hpp"
+#include "coloc/BoundedQueue.hpp"
+#include "coloc/AsyncWorker.hpp"
+#include "coloc/InterScheduler.hpp"
+#include "coloc/FrameSupervisor.hpp"
+#include "coloc/ThreadPool.hpp"
 
 #include <experimental/filesystem>
 #include <chrono>
 #include <ctime>
+#include <future>
+#include <thread>
+#include <algorithm>
 
 //#define DEBUG 0
 
@@ -29,9 +39,11 @@ class ColoC
 {
 public:
 	ColoC(unsigned int& _nDrones, int& nImageStart, colocParams& _params, DetectorOptions& _dOpts, MatcherOptions& _mOpts)
-		: params(_params), detector(_dOpts), matcher(_mOpts), robustMatcher(_params), reconstructor(_params),
-		localizer(_params), colocInterface(_dOpts, _params, data), filter(_nDrones)
+		: params(_params), dOpts(_dOpts), mOpts(_mOpts), detector(_dOpts), matcher(_mOpts), robustMatcher(_params), reconstructor(_params),
+		colocInterface(_dOpts, _params, data), filter(_nDrones, _params.imageFolder), interPairs(Utils::interPairs(_params.interPairs, _nDrones)),
+		supervisor(params, _nDrones), interWorker([this](InterRequest& request) { return computeInterEstimate(request); }, std::max<size_t>(1, interPairs.size()))
 	{
+		ThreadPool::configure(params.numThreads);
 		data.numDrones = _nDrones;
 		for (unsigned int i = 0; i < data.numDrones; ++i) {
 			data.filenames.push_back("");
@@ -40,6 +52,10 @@ public:
 			currentPoses.push_back(Pose3(Mat3::Identity(), Vec3::Zero()));
 			currentCov.push_back(Cov6());
 			trackCounts.push_back(0);
+
+			localizers.emplace_back(new Localizer(params));
+			kltTrackers.emplace_back(new KLTTracker());
+			droneRegions.emplace_back();
 		}
 		this->imageNumber = nImageStart;
 		this->mapReady = false;
@@ -60,17 +76,28 @@ private:
 	//FeatureDetectorGPU gpuDetector{ 1.2f, 8, 640, 480, 5000 };
 	//GPUMatcher gpuMatcher{ 5, 5000 };
 
+	// The map worker detects with mapDetector, so that its frames don't share buffers or
+	// thresholds with the tracking detection running at the same time
 #ifdef USE_CUDA
 	FeatureDetector <bool, GPUDetector> detector{ dOpts };
+	// Map updates run on the tracking thread with CUDA (see updateMap)
+	FeatureDetector <bool, GPUDetector>& mapDetector = detector;
 	FeatureMatcher <bool, GPUMatcher> matcher{ mOpts };
+#elif defined(USE_KORAL_CPU)
+	FeatureDetector <bool, CPUKoralDetector> detector{ dOpts };
+	FeatureDetector <bool, CPUKoralDetector> mapDetector{ dOpts };
+	FeatureMatcher <bool, CPUMatcher> matcher{ mOpts };
 #else
 	FeatureDetector <bool, CPUDetector> detector{ dOpts };
+	FeatureDetector <bool, CPUDetector> mapDetector{ dOpts };
 	FeatureMatcher <bool, CPUMatcher> matcher{ mOpts };
 #endif
 	RobustMatcher robustMatcher{ params };
 	Reconstructor reconstructor{ params };
-	Localizer localizer{ params };
-	colocFilter filter{ data.numDrones };
+	std::vector <std::unique_ptr<Localizer>> localizers;
+	// Optical flow tracks of each drone, see colocParams::kltTracking
+	std::vector <std::unique_ptr<KLTTracker>> kltTrackers;
+	colocFilter filter{ data.numDrones, params.imageFolder };
 	CovIntersection covIntOptimizer;
 
 	std::string matchesFile = params.imageFolder + "matches.svg";
@@ -92,6 +119,22 @@ private:
 	std::vector <Cov6> currentCov;
 	std::vector <int> trackCounts;
 
+	// Per-drone scratch regions for the current frame, detected concurrently
+	// and only published to data.regions once every drone has been tracked.
+	std::vector <FeatureMap> droneRegions;
+
+	// Map the trackers localize against. Replaced as a whole by publishMap(), never
+	// modified in place; always read through currentMap().
+	MapSnapshot map;
+
+	// Drone pairs inter-MAV estimation runs on, and the worker's workspace (never touched by the trackers)
+	std::vector <Pair> interPairs;
+	InterScheduler interScheduler{ params };
+	FrameSupervisor supervisor;
+	colocData interData;
+	AsyncWorker <InterRequest, InterEstimate> interWorker;
+	AsyncWorker <MapRequest, bool> mapWorker{ [this](MapRequest& request) { return buildMap(request); } };
+
 public:
 	void mainThread()
 	{
@@ -113,42 +156,185 @@ public:
 				auto start = std::chrono::steady_clock::now();
 				colocInterface.processImages(droneIds);
 				auto end = std::chrono::steady_clock::now();
-				std::cout << "Feature detection for two images : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+				std::cout << "Feature detection for " << droneIds.size() << " images : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
 				
 				start = std::chrono::steady_clock::now();
-				initMap(droneIds, 3.0);
+				const bool created = initMap(droneIds, 3.0) == EXIT_SUCCESS;
 				end = std::chrono::steady_clock::now();
 				std::cout << "Map construction : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
 
+				// Try again with the next frames
+				if (!created) {
+					if (++colocInterface.imageNumber >= params.numFrames)
+						stopThread = true;
+					continue;
+				}
+
 				mapReady = true;
 				colocInterface.imageNumber = 0;
+				supervisor.start(colocInterface.imageNumber);
 			}
 			
 			this->imageNumber = colocInterface.imageNumber;
-			for (int i = 0; i < 2; ++i) {
+#ifdef USE_CUDA
+			// The GPU detector and matcher share device buffers between calls
+			const bool parallelIntra = false, pipelined = false;
+#else
+			const bool parallelIntra = params.parallelIntra, pipelined = params.pipelined;
+#endif
+			if (pipelined) {
+				// Runs all remaining frames, including the inter-MAV step
+				pipelinedIntraPoseEstimator(droneIds);
+				continue;
+			}
+
+			if (params.deadlineMode && !supervisor.admit(colocInterface.imageNumber)) {
+				if (colocInterface.imageNumber >= params.numFrames)
+					stopThread = true;
+				continue;
+			}
+			this->imageNumber = colocInterface.imageNumber;
+
+			if (parallelIntra) {
 				auto start = std::chrono::steady_clock::now();
-				colocInterface.processImageSingle(i);
+				parallelIntraPoseEstimator(droneIds);
 				auto end = std::chrono::steady_clock::now();
-				std::cout << "Detection in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()<< " ms" << std::endl;
-				start = std::chrono::steady_clock::now();
-				intraPoseEstimator(i, currentPoses[i], currentCov[i]);
-				end = std::chrono::steady_clock::now();
-				std::cout << "Intra-MAV in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()<< " ms" << std::endl;
-				
+				std::cout << "Parallel intra-MAV in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
 			}
-			auto start = std::chrono::steady_clock::now();
-			if ((colocInterface.imageNumber == 0)) {
-				interPoseEstimator(0, 1);
+			else {
+				for (int& i : droneIds) {
+					if (params.kltTracking) {
+						auto start = std::chrono::steady_clock::now();
+						if (kltIntraPoseEstimator(i, colocInterface.imageNumber, data.regions, data.filenames[i]))
+							data.scene.views[i].reset(new View(data.filenames[i], i, 0, i, params.imageSize.first, params.imageSize.second));
+						auto end = std::chrono::steady_clock::now();
+						std::cout << "Intra-MAV in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+						continue;
+					}
+					auto start = std::chrono::steady_clock::now();
+					colocInterface.processImageSingle(i);
+					auto end = std::chrono::steady_clock::now();
+					std::cout << "Detection in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()<< " ms" << std::endl;
+					start = std::chrono::steady_clock::now();
+					intraPoseEstimator(i, currentPoses[i], currentCov[i]);
+					end = std::chrono::steady_clock::now();
+					std::cout << "Intra-MAV in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()<< " ms" << std::endl;
+				}
 			}
+			auto start = std::chrono::steady_clock::now();
+			collectInterEstimates();
+			if (interDue(colocInterface.imageNumber))
+				scheduleInterPairs();
 			auto end = std::chrono::steady_clock::now();
 			std::cout << "Inter-MAV in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+
+			collectMapUpdates();
+			if (updateMapNow) {
+				updateMap(droneIds);
+				updateMapNow = false;
+			}
+			if (params.deadlineMode)
+				supervisor.finished(colocInterface.imageNumber);
 			colocInterface.imageNumber++;
-			//if (colocInterface.imageNumber == 400)
+			if (colocInterface.imageNumber >= params.numFrames)
 				stopThread = true;
 		}
+
+		shutdown();
 	}
 
-	void initMap(std::vector <int> droneIds, float scale = 1.0)
+	// Waits for the inter-MAV estimates and map updates still in flight
+	void shutdown()
+	{
+		interWorker.finish();
+		mapWorker.finish();
+		collectInterEstimates();
+		collectMapUpdates();
+
+		if (params.deadlineMode)
+			supervisor.report();
+	}
+
+	// Entry points for feeding frames from memory (see coloc::Engine) instead of
+	// running mainThread() on the interface. Frames of one cycle share a number.
+	bool isMapReady() const
+	{
+		return mapReady;
+	}
+
+	void setFrameNumber(unsigned int number)
+	{
+		this->imageNumber = colocInterface.imageNumber = number;
+	}
+
+	// Makes regions the current frame of droneId, as the interface does for images read from disk
+	void setFrame(int droneId, std::unique_ptr<AKAZE_Binary_Regions> regions, const std::string& name)
+	{
+		data.filenames[droneId] = name;
+		data.regions[droneId] = std::move(regions);
+		data.scene.views[droneId].reset(new View(data.filenames[droneId], droneId, 0, droneId, params.imageSize.first, params.imageSize.second));
+	}
+
+	// Builds the initial map from the current frames of droneIds; their poses in the map are returned
+	bool createMap(std::vector <int>& droneIds, std::vector <Pose3>& poses)
+	{
+		mapReady = initMap(droneIds, 3.0) == EXIT_SUCCESS;
+
+		poses.clear();
+		for (int& id : droneIds) {
+			const auto view = data.scene.views.find(id);
+			if (view != data.scene.views.end() && data.scene.poses.count(view->second->id_pose))
+				poses.push_back(data.scene.poses.at(view->second->id_pose));
+			else
+				poses.push_back(Pose3(Mat3::Identity(), Vec3::Zero()));
+		}
+		return mapReady ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Localizes and filters one frame; safe to call for different drones concurrently.
+	// The frame is not published; call setFrame() once all drones of the cycle are done.
+	bool trackFrame(int droneId, AKAZE_Binary_Regions& queryRegions, Pose3& pose, Cov6& cov, int& nTracks)
+	{
+		bool status = intraPoseEstimator(droneId, queryRegions, currentPoses[droneId], currentCov[droneId]);
+		pose = currentPoses[droneId];
+		cov = currentCov[droneId];
+		nTracks = trackCounts[droneId];
+		return status;
+	}
+
+	// Where the drone's next frame should be detected, empty for the whole frame (see colocParams::roiDetection)
+	std::vector <ImageWindow> detectionWindows(int droneId)
+	{
+		return colocInterface.detectionWindows.get(droneId);
+	}
+
+	// Fuses finished inter-MAV estimates and, when due, schedules new ones for this cycle
+	void interStep()
+	{
+		collectInterEstimates();
+		collectMapUpdates();
+		if (interDue(colocInterface.imageNumber))
+			scheduleInterPairs();
+	}
+
+	// Latest published map. Callers keep the returned reference for the whole frame
+	// so that matching and PnP see the same map even if a newer one is published.
+	MapSnapshot currentMap() const
+	{
+		return std::atomic_load(&map);
+	}
+
+	void publishMap(MapSnapshot next)
+	{
+#ifdef USE_CUDA
+		matcher.setMapData(next->mapRegions->RegionCount(), const_cast<unsigned int*>(static_cast<const unsigned int*>(next->mapRegions->DescriptorRawData())));
+#endif
+		std::atomic_store(&map, next);
+	}
+
+	// Builds the map from the current frames and publishes it. Returns EXIT_FAILURE, publishing
+	// nothing, if the reconstruction fails or has fewer than params.minMapLandmarks landmarks.
+	bool initMap(std::vector <int> droneIds, float scale = 1.0)
 	{
 #ifdef DEBUG
 		std::string num = std::string(4 - std::to_string(colocInterface.imageNumber).length(), '0') + std::to_string(colocInterface.imageNumber);
@@ -158,6 +344,13 @@ public:
 		utils.drawFeatures(filenameFeat, params.imageSize, data.regions[droneIds[0]]->Features(), FeatFile);
 #endif
 
+		// Start over from an earlier attempt
+		data.putativeMatches.clear();
+		data.geometricMatches.clear();
+		data.relativePoses.clear();
+		data.scene.structure.clear();
+		data.scene.poses.clear();
+
 		auto start = std::chrono::steady_clock::now();
 		matcher.computeMatches(data.regions, data.putativeMatches);
 		auto end = std::chrono::steady_clock::now();
@@ -177,15 +370,19 @@ public:
 
 		std::cout << "Creating map" << std::endl;
 		start = std::chrono::steady_clock::now();
-		reconstructor.reconstructScene(0, data, currentPoses, scale, true);
+		const bool reconstructed = reconstructor.reconstructScene(0, data, currentPoses, scale, true) == EXIT_SUCCESS;
 		end = std::chrono::steady_clock::now();
 		std::cout << "Reconstruction in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+		if (!reconstructed || data.scene.GetLandmarks().size() < params.minMapLandmarks) {
+			std::cout << "Map initialization failed with " << data.scene.GetLandmarks().size() << " landmarks" << std::endl;
+			return EXIT_FAILURE;
+		}
 
 		std::string mapFile = params.imageFolder + "newmap.ply";
 		logger.logMaptoPLY(data.scene, mapFile);
 		data.scene.s_root_path = params.imageFolder;
 
-		mapReady = data.setupMapDatabase(0);
+		data.setupMapDatabase(0);
 #ifdef DEBUG
 		std::string mapFeatFile = params.imageFolder + "OriginalMap_Features.svg";
 		utils.drawFeatures(data.filenames[0], params.imageSize, data.mapRegions->Features(), mapFeatFile);
@@ -193,19 +390,55 @@ public:
 		for (unsigned int i = 0; i < data.numDrones; ++i) 
 			data.keyframeNames[i] = data.filenames[i];
 
-#ifdef USE_CUDA
-		matcher.setMapData(data.mapRegions->RegionCount(), const_cast<unsigned int*>(static_cast<const unsigned int*>(data.mapRegions->DescriptorRawData())));
-#endif
+		publishMap(data.snapshotMap());
+		return EXIT_SUCCESS;
+	}
+
+	// Detects, matches against the map and localizes every drone at the same time, as
+	// tasks on the shared pool. Every drone reads the map snapshot that was current when
+	// its frame was matched.
+	void parallelIntraPoseEstimator(std::vector <int>& droneIds)
+	{
+		// Drones whose frame was detected, all of them unless KLT tracking skipped some
+		std::vector <char> detected(droneIds.size(), 1);
+		ThreadPool::instance().parallelFor(0, droneIds.size(), [&](size_t i) {
+			int& id = droneIds[i];
+			if (params.kltTracking) {
+				detected[i] = kltIntraPoseEstimator(id, colocInterface.imageNumber, droneRegions[id], data.filenames[id]);
+				return;
+			}
+			auto start = std::chrono::steady_clock::now();
+			colocInterface.processImageSingle(id, colocInterface.imageNumber, droneRegions[id], data.filenames[id]);
+			auto end = std::chrono::steady_clock::now();
+			std::cout << "Detection in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+
+			intraPoseEstimator(id, *droneRegions[id].at(id), currentPoses[id], currentCov[id]);
+		});
+
+		// Publish the new frames now that nobody is reading the shared data
+		for (size_t i = 0; i < droneIds.size(); ++i) {
+			if (!detected[i])
+				continue;
+			const int id = droneIds[i];
+			data.regions[id] = std::move(droneRegions[id].at(id));
+			data.scene.views[id].reset(new View(data.filenames[id], id, 0, id, params.imageSize.first, params.imageSize.second));
+		}
 	}
 
-	void intraPoseEstimator(int& droneId, Pose3& pose, Cov6& cov)
+	bool intraPoseEstimator(int& droneId, Pose3& pose, Cov6& cov)
+	{
+		return intraPoseEstimator(droneId, *data.regions.at(droneId), pose, cov);
+	}
+
+	// 'inlierPoints', if given, receives the image positions and landmarks of the inliers
+	bool intraPoseEstimator(int& droneId, AKAZE_Binary_Regions& queryRegions, Pose3& pose, Cov6& cov, Correspondences* inlierPoints = nullptr)
 	{
 #ifdef DEBUG
 		std::string num = std::string(4 - std::to_string(colocInterface.imageNumber).length(), '0') + std::to_string(colocInterface.imageNumber);
 		std::cout << colocInterface.imageNumber << std::endl;
 		std::string filenameFeat = params.imageFolder + "img__Quad" + std::to_string(droneId) + "_" + num + ".png";
 		std::string FeatFile = params.imageFolder + "Feats_" + std::to_string(droneId) + std::to_string(colocInterface.imageNumber) + ".svg";
-		utils.drawFeatures(filenameFeat, params.imageSize, data.regions[droneId]->Features(), FeatFile);
+		utils.drawFeatures(filenameFeat, params.imageSize, queryRegions.Features(), FeatFile);
 #endif
 		cov = Cov6();
 		std::cout << colocInterface.imageNumber << " - INTRA" << std::endl;
@@ -214,20 +447,20 @@ public:
 		int nTracks;
 		IndMatches mapMatches, inlierMatches;
 		std::vector <uint32_t> inliers;
-		if (mapReady) {
-			auto start = std::chrono::steady_clock::now();
-			matcher.matchSceneWithMap(droneId, data, mapMatches);
-			auto end = std::chrono::steady_clock::now();
-			std::cout << "Tracking in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
-			start = std::chrono::steady_clock::now();
-			locStatus = localizer.localizeImage(droneId, pose, data, cov, rmse, mapMatches, inliers);
-			end = std::chrono::steady_clock::now();
-			std::cout << "PNP in ms: " << std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count() << " ms" << std::endl;
+		MapSnapshot map = currentMap();
+		if (mapReady && map) {
+			matchStage(*map, queryRegions, mapMatches);
+			locStatus = localizeStage(droneId, *map, queryRegions, mapMatches, pose, cov, rmse, inliers);
+			if (inlierPoints && locStatus == EXIT_SUCCESS) {
+				for (uint32_t k : inliers) {
+					const Vec2 point = queryRegions.GetRegionPosition(mapMatches[k].j_);
+					inlierPoints->points.emplace_back(static_cast<float>(point[0]), static_cast<float>(point[1]));
+					inlierPoints->landmarks.push_back(map->scene.GetLandmarks().at(map->mapRegionIdx[mapMatches[k].i_]).X);
+				}
+			}
 		}
 		
 		nTracks = inliers.size();
-		std::cout << "Number of matches with map " << nTracks << std::endl;
-		trackCounts[droneId] = nTracks;
 
 #ifdef DEBUG
 		for (int i = 0; i < inliers.size(); i++)
@@ -235,13 +468,101 @@ public:
 		std::string matchesFile = params.imageFolder + "matchesIMG" + std::to_string(colocInterface.imageNumber) + ".svg";
 		std::string number = std::string(4 - std::to_string(colocInterface.imageNumber).length(), '0') + std::to_string(colocInterface.imageNumber);
 		std::string filename = params.imageFolder + "img__Quad" + std::to_string(droneId) + "_" + number + ".png";
-		utils.drawMatches(params.imageSize, matchesFile, data.keyframeNames[0], filename, *data.mapRegions.get(), *data.regions[droneId].get(), inlierMatches);
+		if (map)
+			utils.drawMatches(params.imageSize, matchesFile, map->keyframeNames[0], filename, *map->mapRegions.get(), queryRegions, inlierMatches);
 #endif
 
+		fuseStage(droneId, colocInterface.imageNumber, locStatus, pose, cov, rmse, nTracks);
+		return locStatus;
+	}
+
+	// KLT mode for one drone's frame. Between keyframes the inliers of the last localized frame
+	// are followed into this frame with optical flow and the pose is computed from them alone.
+	// Keyframes, and frames where too few tracks survive, are detected into 'regions' and matched
+	// with the map as usual, and the tracks start again from their inliers. Returns true when the
+	// frame was detected; 'filename' is only updated then.
+	bool kltIntraPoseEstimator(int& droneId, unsigned int number, FeatureMap& regions, std::string& filename)
+	{
+		KLTTracker& klt = *kltTrackers[droneId];
+		GrayImage image;
+		std::string name;
+		if (colocInterface.readFrame(droneId, number, image, name) == EXIT_FAILURE) {
+			klt.clear();
+			colocInterface.processImageSingle(droneId, number, regions, filename);
+			intraPoseEstimator(droneId, *regions.at(droneId), currentPoses[droneId], currentCov[droneId]);
+			return true;
+		}
+
+		const bool keyframe = !mapReady || !klt.active() || klt.age() + 1 >= params.kltKeyframeInterval
+			|| interDue(number) || updateMapNow;
+		if (!keyframe) {
+			auto start = std::chrono::steady_clock::now();
+			const size_t tracked = klt.track(image);
+			if (tracked >= params.kltMinTracks) {
+				Pose3 pose = currentPoses[droneId];
+				Cov6 cov = Cov6();
+				float rmse = 10.0;
+				std::vector <uint32_t> inliers;
+				const Correspondences& tracks = klt.correspondences();
+				const bool locStatus = localizers[droneId]->localizePoints(droneId, pose, tracks.points, tracks.landmarks, cov, rmse, inliers);
+				auto end = std::chrono::steady_clock::now();
+				std::cout << "KLT tracking of " << tracked << " points in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+				if (locStatus == EXIT_SUCCESS && inliers.size() >= params.kltMinTracks) {
+					klt.keep(inliers);
+					std::cout << number << " - INTRA (KLT)" << std::endl;
+					currentPoses[droneId] = pose;
+					currentCov[droneId] = cov;
+					fuseStage(droneId, number, locStatus, currentPoses[droneId], currentCov[droneId], rmse, static_cast<int>(inliers.size()));
+					return false;
+				}
+			}
+			std::cout << "KLT tracks lost, detecting frame " << number << " in full" << std::endl;
+		}
+
+		filename = name;
+		auto start = std::chrono::steady_clock::now();
+		colocInterface.processImageSingle(droneId, regions, image);
+		auto end = std::chrono::steady_clock::now();
+		std::cout << "Detection in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+
+		Correspondences inlierPoints;
+		if (intraPoseEstimator(droneId, *regions.at(droneId), currentPoses[droneId], currentCov[droneId], &inlierPoints) == EXIT_SUCCESS)
+			klt.reset(image, std::move(inlierPoints));
+		else
+			klt.clear();
+		return true;
+	}
+
+	// Stage 2 of intra-MAV estimation: match the frame's features against the map
+	void matchStage(const colocData& map, AKAZE_Binary_Regions& queryRegions, IndMatches& mapMatches)
+	{
+		auto start = std::chrono::steady_clock::now();
+		matcher.matchRegionsWithMap(map, queryRegions, mapMatches);
+		auto end = std::chrono::steady_clock::now();
+		std::cout << "Tracking in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+	}
+
+	// Stage 3: PnP and pose refinement from the 2D-3D matches
+	// against the same map the frame was matched with
+	bool localizeStage(int& droneId, const colocData& map, AKAZE_Binary_Regions& queryRegions, IndMatches& mapMatches, Pose3& pose, Cov6& cov, float& rmse, std::vector <uint32_t>& inliers)
+	{
+		auto start = std::chrono::steady_clock::now();
+		bool locStatus = localizers[droneId]->localizeImage(droneId, pose, map, queryRegions, cov, rmse, mapMatches, inliers);
+		auto end = std::chrono::steady_clock::now();
+		std::cout << "PNP in ms: " << std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count() << " ms" << std::endl;
+		return locStatus;
+	}
+
+	// Stage 4: log the raw estimate and fuse it into the drone's Kalman filter
+	void fuseStage(int& droneId, unsigned int number, bool locStatus, Pose3& pose, Cov6& cov, float& rmse, int nTracks)
+	{
+		std::cout << "Number of matches with map " << nTracks << std::endl;
+		trackCounts[droneId] = nTracks;
+
 		if (locStatus == EXIT_SUCCESS) {
-			logger.logPoseCovtoFile(colocInterface.imageNumber, droneId, droneId, pose, cov, rmse, nTracks, poseFile);
+			logger.logPoseCovtoFile(number, droneId, droneId, pose, cov, rmse, nTracks, poseFile);
 			logger.logPosetoPLY(pose, mapFile);
-			filter.fillMeasurements(filter.droneMeasurements[droneId], pose.center(), pose.rotation());
+			filter.fillMeasurements(droneId, pose.center(), pose.rotation());
 		}
 		else {
 			if (cov.size() == 0) {
@@ -253,7 +574,7 @@ public:
 			}
 
 			Pose3 failurePose = Pose3(Mat3::Identity(), Vec3::Zero());
-			logger.logPoseCovtoFile(colocInterface.imageNumber, droneId, droneId, failurePose, cov, rmse, nTracks, poseFile);
+			logger.logPoseCovtoFile(number, droneId, droneId, failurePose, cov, rmse, nTracks, poseFile);
 		}
 
 		filter.update(droneId, pose, cov, rmse);
@@ -268,76 +589,251 @@ public:
 		}
 		std::copy_n(array.begin(), 36, cov.begin());
 
-		logger.logPoseCovtoFile(colocInterface.imageNumber, droneId, droneId, pose, cov, rmse, nTracks, filtPoseFile);
+		logger.logPoseCovtoFile(number, droneId, droneId, pose, cov, rmse, nTracks, filtPoseFile);
+
+		if (params.roiDetection)
+			predictDetectionWindows(droneId, locStatus);
 	}
 
+	// Decides where the drone's next frame is detected: while it is tracked, only where the
+	// map's landmark volumes reproject from the pose its filter predicts; after a tracking
+	// failure, or without a map, the whole frame
+	void predictDetectionWindows(int droneId, bool locStatus)
+	{
+		std::vector <ImageWindow> windows;
+		MapSnapshot map = currentMap();
+		if (locStatus == EXIT_SUCCESS && mapReady && map && !params.K.empty()) {
+			const Mat3& K = params.K[std::min<size_t>(droneId, params.K.size() - 1)];
+			windows = predictWindows(map->landmarkVolumes, filter.predictedPose(droneId), K,
+				params.imageSize.first, params.imageSize.second, params.roiMargin);
+		}
+		if (!windows.empty())
+			std::cout << "Next frame detected in " << windows.size() << " windows, "
+				<< static_cast<int>(100.0 * windowsArea(windows) / (static_cast<double>(params.imageSize.first) * params.imageSize.second)) << "% of the image" << std::endl;
+		colocInterface.detectionWindows.set(droneId, std::move(windows));
+	}
+
+	// Runs detection, map matching, localization and fusion as four concurrent stages,
+	// so frame N+1 is detected while frame N is localized and frame N-1 is fused.
+	// Each stage hands frames to the next through a bounded queue; a slow stage
+	// blocks the ones upstream of it instead of letting frames pile up.
+	void pipelinedIntraPoseEstimator(std::vector <int>& droneIds)
+	{
+		typedef std::unique_ptr<TrackingFrame> FramePtr;
+		BoundedQueue<FramePtr> detected(params.pipelineDepth), matched(params.pipelineDepth), localized(params.pipelineDepth);
+		const unsigned int firstFrame = colocInterface.imageNumber;
+
+		std::thread detectThread([&]() {
+			unsigned int number = firstFrame;
+			while (number < params.numFrames && !stopThread) {
+				// In deadline mode detection jumps straight to the newest frame
+				if (params.deadlineMode && !supervisor.admit(number))
+					continue;
+
+				for (int& id : droneIds) {
+					FramePtr frame(new TrackingFrame(id, number));
+					auto start = std::chrono::steady_clock::now();
+					colocInterface.processImageSingle(frame->droneId, number, frame->regions, frame->filename);
+					auto end = std::chrono::steady_clock::now();
+					std::cout << "Detection in milliseconds : " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+					detected.push(std::move(frame));
+				}
+				++number;
+			}
+			detected.close();
+		});
+
+		std::thread matchThread([&]() {
+			FramePtr frame;
+			while (detected.pop(frame)) {
+				frame->map = currentMap();
+				matchStage(*frame->map, frame->query(), frame->mapMatches);
+				matched.push(std::move(frame));
+			}
+			matched.close();
+		});
+
+		std::thread localizeThread([&]() {
+			FramePtr frame;
+			while (matched.pop(frame)) {
+				frame->locStatus = localizeStage(frame->droneId, *frame->map, frame->query(), frame->mapMatches, frame->pose, frame->cov, frame->rmse, frame->inliers);
+				frame->map.reset();
+				localized.push(std::move(frame));
+			}
+			localized.close();
+		});
+
+		// Fusion, and publishing the frame for inter-MAV estimation, stay on this thread
+		FramePtr frame;
+		size_t fused = 0;
+		while (localized.pop(frame)) {
+			const int id = frame->droneId;
+			std::cout << frame->imageNumber << " - INTRA" << std::endl;
+			fuseStage(frame->droneId, frame->imageNumber, frame->locStatus, frame->pose, frame->cov, frame->rmse, static_cast<int>(frame->inliers.size()));
+			currentPoses[id] = frame->pose;
+			currentCov[id] = frame->cov;
+
+			data.filenames[id] = frame->filename;
+			data.regions[id] = std::move(frame->regions.at(id));
+			data.scene.views[id].reset(new View(data.filenames[id], id, 0, id, params.imageSize.first, params.imageSize.second));
+
+			if (++fused % droneIds.size() == 0) {
+				if (params.deadlineMode)
+					supervisor.finished(frame->imageNumber);
+				this->imageNumber = colocInterface.imageNumber = frame->imageNumber;
+				collectInterEstimates();
+				collectMapUpdates();
+				if (interDue(frame->imageNumber))
+					scheduleInterPairs();
+			}
+		}
+
+		detectThread.join();
+		matchThread.join();
+		localizeThread.join();
+
+		colocInterface.imageNumber = std::max(firstFrame, params.numFrames);
+		stopThread = true;
+	}
+
+	bool interDue(unsigned int number) const
+	{
+		return params.interPeriod == 0 ? number == 0 : number % params.interPeriod == 0;
+	}
+
+	// Runs inter-MAV estimation for the best ranked of the configured pairs, so the
+	// cost per cycle is bounded by params.interMaxPairs and params.interBudgetMs
+	void scheduleInterPairs()
+	{
+		for (const Pair& pair : interScheduler.select(interPairs, trackCounts, currentPoses, currentCov))
+			interPoseEstimator(pair.first, pair.second);
+	}
+
+	// Hands a snapshot of the pair to the background worker (or processes it inline
+	// when params.asyncInter is off); results are fused by collectInterEstimates().
 	void interPoseEstimator(int sourceId, int destId)
 	{
-		std::string matchesFile = params.imageFolder + "matchesInter_" + std::to_string(colocInterface.imageNumber) + ".svg";
+#ifdef USE_CUDA
+		// The GPU matcher cannot be shared with the tracking thread
+		const bool asyncInter = false;
+#else
+		const bool asyncInter = params.asyncInter;
+#endif
+		InterRequest request = makeInterRequest(sourceId, destId);
+		if (asyncInter) {
+			if (!interWorker.submit(std::move(request)))
+				std::cout << "Inter-MAV worker busy, skipping pair " << sourceId << " & " << destId << std::endl;
+		}
+		else {
+			InterEstimate estimate = computeInterEstimate(request);
+			fuseInterEstimate(estimate);
+		}
+	}
 
-		std::cout << colocInterface.imageNumber << " - INTER" << std::endl;
-		data.tempScene = {};
+	// Fuses every inter-MAV estimate the worker has finished since the last call
+	void collectInterEstimates()
+	{
+		InterEstimate estimate;
+		while (interWorker.poll(estimate))
+			fuseInterEstimate(estimate);
+	}
 
-		data.tempScene.views[sourceId].reset(new View(data.filenames[sourceId], sourceId, 0, 0, params.imageSize.first, params.imageSize.second));
-		data.tempScene.views[destId].reset(new View(data.filenames[destId], destId, 1, 1, params.imageSize.first, params.imageSize.second));
+	InterRequest makeInterRequest(int sourceId, int destId)
+	{
+		InterRequest request;
+		request.sourceId = sourceId;
+		request.destId = destId;
+		request.imageNumber = colocInterface.imageNumber;
+		request.stamp = std::chrono::steady_clock::now();
+		request.regions[sourceId].reset(new AKAZE_Binary_Regions(*data.regions.at(sourceId)));
+		request.regions[destId].reset(new AKAZE_Binary_Regions(*data.regions.at(destId)));
+		request.sourceFilename = data.filenames[sourceId];
+		request.destFilename = data.filenames[destId];
+		request.sourcePose = currentPoses[sourceId];
+		return request;
+	}
+
+	// Builds a temporary scene from the pair, rescales it to the map and bundle adjusts it.
+	// Only reads the map and works in interData, so it can run next to the trackers.
+	InterEstimate computeInterEstimate(InterRequest& request)
+	{
+		const int sourceId = request.sourceId, destId = request.destId;
+		colocData &work = interData;
+		auto start = std::chrono::steady_clock::now();
+		MapSnapshot map = currentMap();
+		InterEstimate estimate;
+		estimate.sourceId = sourceId;
+		estimate.destId = destId;
+		estimate.imageNumber = request.imageNumber;
+		estimate.stamp = request.stamp;
+		if (!map) {
+			std::cout << "No existing map. Inter-MAV estimation cannot continue." << std::endl;
+			return estimate;
+		}
+
+		std::string matchesFile = params.imageFolder + "matchesInter_" + std::to_string(request.imageNumber) + ".svg";
+
+		std::cout << request.imageNumber << " - INTER" << std::endl;
+		work.regions = std::move(request.regions);
+		work.putativeMatches.clear();
+		work.geometricMatches.clear();
+		work.relativePoses.clear();
+		work.tempScene = {};
+
+		work.tempScene.views[sourceId].reset(new View(request.sourceFilename, sourceId, sourceId, 0, params.imageSize.first, params.imageSize.second));
+		work.tempScene.views[destId].reset(new View(request.destFilename, destId, destId, 1, params.imageSize.first, params.imageSize.second));
 
 		Pair interPosePair = std::make_pair <IndexT, IndexT>((IndexT)sourceId, (IndexT)destId);
 
 		IndMatches pairMatches;
-		matcher.computeMatchesPair(interPosePair, data.regions, pairMatches);
-
-		PairWiseMatches::iterator it = data.putativeMatches.find(interPosePair);
-		if (data.putativeMatches.end() != it)
-			data.putativeMatches.at(interPosePair) = pairMatches;
-		else
-			data.putativeMatches.insert({ { interPosePair.first, interPosePair.second }, std::move(pairMatches) });
+		matcher.computeMatchesPair(interPosePair, work.regions, pairMatches);
+		work.putativeMatches.insert({ { interPosePair.first, interPosePair.second }, std::move(pairMatches) });
 
-		data.putativeMatches.at(interPosePair) = pairMatches;
-		bool status = robustMatcher.filterMatchesPair(interPosePair, data.regions, data.putativeMatches, data.geometricMatches, data.relativePoses);
+		bool status = robustMatcher.filterMatchesPair(interPosePair, work.regions, work.putativeMatches, work.geometricMatches, work.relativePoses);
 
+		coloc::Utils tempUtils;
 #ifdef DEBUG
-		utils.drawMatches(params.imageSize, matchesFile, data.filenames[sourceId], data.filenames[destId], *data.regions[sourceId].get(), *data.regions[destId].get(), data.geometricMatches.at(interPosePair));
+		tempUtils.drawMatches(params.imageSize, matchesFile, request.sourceFilename, request.destFilename, *work.regions[sourceId].get(), *work.regions[destId].get(), work.geometricMatches.at(interPosePair));
 #endif
-		data.tempScene.structure.clear();
+		work.tempScene.structure.clear();
 
 		std::cout << "Creating temporary map" << std::endl;
 		coloc::Reconstructor tempReconstructor(params);
-		coloc::Utils tempUtils;
-		tempReconstructor.interReconstruct(sourceId, destId, data);
+		tempReconstructor.interReconstruct(sourceId, destId, work);
 
 		PoseRefiner refiner;
-		float rmse;
+		float rmse = 0.0;
 		Cov6 cov;
 		//const Optimize_Options refinementOptions(Intrinsic_Parameter_Type::NONE, Extrinsic_Parameter_Type::ADJUST_ALL, Structure_Parameter_Type::ADJUST_ALL);
-		//refiner.refinePose(data.tempScene, refinementOptions, rmse, cov);
+		//refiner.refinePose(work.tempScene, refinementOptions, rmse, cov);
 
-		data.tempScene.s_root_path = params.imageFolder;
+		work.tempScene.s_root_path = params.imageFolder;
 
 		bool isInter = true;
-		data.setupMapDatabase(isInter);
+		work.setupMapDatabase(isInter);
 
-		//std::string newMapFile = params.imageFolder + "newmap_" + std::to_string(colocInterface.imageNumber) + ".ply";
-		//logger.logMaptoPLY(data.tempScene, newMapFile);
+		//std::string newMapFile = params.imageFolder + "newmap_" + std::to_string(request.imageNumber) + ".ply";
+		//logger.logMaptoPLY(work.tempScene, newMapFile);
 
 		std::vector <IndMatch> commonFeatures; 
-		matcher.matchMapFeatures(data.mapRegions, data.interMapRegions, commonFeatures);
-		Vec3 poseDiff = currentPoses[sourceId].center() - data.scene.poses[0].center();
-		Mat3 rotDiff = currentPoses[sourceId].rotation();
-		robustMatcher.matchMaps(data.mapRegions, data.interMapRegions, commonFeatures, poseDiff, rotDiff);
-		//std::string matchesFileMap = params.imageFolder + "matchesMap_" + std::to_string(destId) + "_" + std::to_string(imageNumber) + ".svg";
+		matcher.matchMapFeatures(map->mapRegions, work.interMapRegions, commonFeatures);
+		Vec3 poseDiff = request.sourcePose.center() - map->scene.poses.at(0).center();
+		Mat3 rotDiff = request.sourcePose.rotation();
+		robustMatcher.matchMaps(map->mapRegions, work.interMapRegions, commonFeatures, poseDiff, rotDiff);
+		//std::string matchesFileMap = params.imageFolder + "matchesMap_" + std::to_string(destId) + "_" + std::to_string(request.imageNumber) + ".svg";
 		double scaleDiff;
 		if (commonFeatures.size() != 0) {
-			//utils.drawMatches(params.imageSize, matchesFileMap, data.keyframeNames[0], data.filenames[0], *data.mapRegions.get(), *data.interMapRegions.get(), commonFeatures);
-			scaleDiff = utils.computeScaleDifference(data.scene, data.mapRegionIdx, data.tempScene, data.interMapRegionIdx, commonFeatures);
+			//tempUtils.drawMatches(params.imageSize, matchesFileMap, map->keyframeNames[0], request.sourceFilename, *map->mapRegions.get(), *work.interMapRegions.get(), commonFeatures);
+			scaleDiff = tempUtils.computeScaleDifference(map->scene, map->mapRegionIdx, work.tempScene, work.interMapRegionIdx, commonFeatures);
 		}
 		else
 			scaleDiff = 1.0;
 		//std::cout << "Found scale difference to be " << scaleDiff << std::endl;
-		utils.rescaleMap(data.tempScene, scaleDiff);
+		tempUtils.rescaleMap(work.tempScene, scaleDiff);
 
 		if (status == EXIT_SUCCESS) {
 			const Optimize_Options refinementOptions2(Intrinsic_Parameter_Type::NONE, Extrinsic_Parameter_Type::ADJUST_ALL, Structure_Parameter_Type::NONE);
-			bool locStatus = refiner.refinePose(data.tempScene, refinementOptions2, rmse, cov);
+			bool locStatus = refiner.refinePose(work.tempScene, refinementOptions2, rmse, cov);
 		}
 
 		if (cov.size() == 0) {
@@ -348,13 +844,32 @@ public:
 			cov = covpose;
 		}
 
-		Vec3 transRotated = data.tempScene.poses.at(destId).center();
-		Pose3 pose = Pose3(data.tempScene.poses.at(destId).rotation() * currentPoses[sourceId].rotation(), transRotated);
-	//	std::string newMapFile = params.imageFolder + "newmap_" + std::to_string(colocInterface.imageNumber) + ".ply";
+		const Pose3 &destPose = work.tempScene.poses.at(work.tempScene.views.at(destId)->id_pose);
+		Vec3 transRotated = destPose.center();
+		estimate.pose = Pose3(destPose.rotation() * request.sourcePose.rotation(), transRotated);
+		estimate.cov = cov;
+		estimate.rmse = rmse;
+		estimate.status = status;
+
+		auto end = std::chrono::steady_clock::now();
+		interScheduler.recordCost({ (IndexT)sourceId, (IndexT)destId }, std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+		return estimate;
+	}
+
+	// Covariance intersection of an inter-MAV estimate with the destination drone's
+	// latest intra-MAV estimate. Runs on the tracking thread.
+	void fuseInterEstimate(InterEstimate& estimate)
+	{
+		const int sourceId = estimate.sourceId, destId = estimate.destId;
+		Pose3 &pose = estimate.pose;
+		Cov6 &cov = estimate.cov;
 		int tracks = 0;
 
+		auto age = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - estimate.stamp).count();
+		std::cout << "Inter-MAV estimate for frame " << estimate.imageNumber << " (" << sourceId << " -> " << destId << ") fused " << age << " ms after snapshot" << std::endl;
+
 		if (true) {
-			logger.logPoseCovtoFile(imageNumber, destId, sourceId, pose, cov, rmse, tracks, poseFile);
+			logger.logPoseCovtoFile(estimate.imageNumber, destId, sourceId, pose, cov, estimate.rmse, tracks, poseFile);
 			//logger.logPosetoPLY(pose, newMapFile);
 			//logger.logMaptoPLY(data.tempScene, newMapFile);
 		}
@@ -388,22 +903,60 @@ public:
 		poseFused.center()[1] = covIntOptimizer.poseFused(1);
 		poseFused.center()[2] = covIntOptimizer.poseFused(2);
 
-		logger.logPoseCovtoFile(imageNumber, destId, sourceId, poseFused, cov, rmse, tracks, filtPoseFile);
+		logger.logPoseCovtoFile(estimate.imageNumber, destId, sourceId, poseFused, cov, estimate.rmse, tracks, filtPoseFile);
+		if (estimate.status == EXIT_SUCCESS)
+			interScheduler.recordFusion(destId, currentCov[destId]);
 	}
 
-	void ColoC::updateMap(std::vector <int> drones)
+	// Requests a new map from the drones' current frames. The map is rebuilt on a
+	// background worker and swapped in when complete; tracking is not interrupted.
+	void updateMap(std::vector <int> drones)
+	{
+#ifdef USE_CUDA
+		// Publishing uploads the map to the GPU matcher, which the trackers are using
+		const bool asyncMapUpdate = false;
+#else
+		const bool asyncMapUpdate = params.asyncMapUpdate;
+#endif
+		MapRequest request;
+		request.drones = drones;
+		request.imageNumber = imageNumber;
+		request.poses = currentPoses;
+
+		if (asyncMapUpdate) {
+			if (!mapWorker.submit(std::move(request)))
+				std::cout << "Map update already in progress, skipping request" << std::endl;
+		}
+		else if (buildMap(request) == EXIT_FAILURE)
+			std::cout << "Map update failed, keeping the previous map" << std::endl;
+	}
+
+	void collectMapUpdates()
+	{
+		bool status;
+		while (mapWorker.poll(status)) {
+			if (status == EXIT_FAILURE)
+				std::cout << "Map update failed, keeping the previous map" << std::endl;
+		}
+	}
+
+	// Reconstructs a map from the requested frames, aligns its scale with the current map
+	// and publishes it. Works in its own colocData; the current map is only read.
+	bool buildMap(MapRequest& request)
 	{
 		colocData updateData;
+		MapSnapshot current = currentMap();
+		std::vector <int>& drones = request.drones;
 		
 		std::string filename;
-		std::string number = std::string(4 - std::to_string(imageNumber).length(), '0') + std::to_string(imageNumber);
+		std::string number = std::string(4 - std::to_string(request.imageNumber).length(), '0') + std::to_string(request.imageNumber);
 		updateData.filenames.clear();
 		for (unsigned int i = 0; i < drones.size(); ++i) {
 			std::string filename = params.imageFolder + "img__Quad" + std::to_string(drones[i]) + "_" + number + ".png";
 			updateData.filenames.push_back(filename);
 			std::cout << updateData.filenames[i] << std::endl;
 
-			detector.detectFeaturesFile(i, updateData.regions, updateData.filenames[i]);
+			mapDetector.detectFeaturesFile(i, updateData.regions, updateData.filenames[i]);
 
 			updateData.scene.views[i].reset(new View(updateData.filenames[i], i, 0, i, params.imageSize.first, params.imageSize.second));
 		}
@@ -420,7 +973,8 @@ public:
 
 		std::cout << "Updating map" << std::endl;
 		Reconstructor updateReconstructor(params);
-		updateReconstructor.reconstructScene(0, updateData, currentPoses, 3.0, true);
+		if (updateReconstructor.reconstructScene(0, updateData, request.poses, 3.0, true) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
 
 		std::string newMapFile = params.imageFolder + "newmap_" + std::to_string(updateNum) + ".ply";
 		updateNum++;
@@ -431,30 +985,31 @@ public:
 		std::string mapFeatFile = params.imageFolder + "UpdatedMap_Features.svg";
 		utils.drawFeatures(updateData.filenames[0], params.imageSize, updateData.mapRegions->Features(), mapFeatFile);
 #endif
+		if (newMapReady == EXIT_FAILURE || updateData.mapRegionIdx.empty())
+			return EXIT_FAILURE;
 
-		if (newMapReady == EXIT_SUCCESS) {
+		if (current) {
 			std::vector <IndMatch> commonFeatures;
 
 			std::string mapmatchesFile = params.imageFolder + "mapmatches_" + std::to_string(updateNum) + ".svg";
-			matcher.matchMapFeatures(data.mapRegions, updateData.mapRegions, commonFeatures); 
+			matcher.matchMapFeatures(current->mapRegions, updateData.mapRegions, commonFeatures); 
 
-			Vec3 poseDiff = updateData.scene.poses[0].center() - data.scene.poses[0].center();
+			Vec3 poseDiff = updateData.scene.poses[0].center() - current->scene.poses.at(0).center();
 			// Mat3 rotDiff = updateData.scene.poses[0].rotation();
-			robustMatcher.matchMaps(data.mapRegions, updateData.mapRegions, commonFeatures, poseDiff, updateData.scene.poses[0].rotation());
-			double scaleDiff = utils.computeScaleDifference(data.scene, data.mapRegionIdx, updateData.scene, updateData.mapRegionIdx, commonFeatures);
+			robustMatcher.matchMaps(current->mapRegions, updateData.mapRegions, commonFeatures, poseDiff, updateData.scene.poses[0].rotation());
+			double scaleDiff = utils.computeScaleDifference(current->scene, current->mapRegionIdx, updateData.scene, updateData.mapRegionIdx, commonFeatures);
 			std::cout << "Scale factor ratio computed during update as " << scaleDiff << std::endl;
 			utils.rescaleMap(updateData.scene, scaleDiff);
 
 #ifdef DEBUG
-			utils.drawMatches(params.imageSize, mapmatchesFile, data.keyframeNames[0], updateData.filenames[0], *data.mapRegions.get(), *updateData.mapRegions.get(), commonFeatures);
+			utils.drawMatches(params.imageSize, mapmatchesFile, current->keyframeNames[0], updateData.filenames[0], *current->mapRegions.get(), *updateData.mapRegions.get(), commonFeatures);
 #endif
 		}
-		
-		data = updateData;
-		data.setupMapDatabase(0);
 
-#ifdef USE_CUDA
-		matcher.setMapData(data.mapRegions->RegionCount(), const_cast<unsigned int*>(static_cast<const unsigned int*>(data.mapRegions->DescriptorRawData())));
-#endif
+		updateData.keyframeNames = updateData.filenames;
+		updateData.numDrones = data.numDrones;
+		publishMap(updateData.snapshotMap());
+		std::cout << "Published updated map with " << updateData.mapRegionIdx.size() << " landmarks" << std::endl;
+		return EXIT_SUCCESS;
 	}
 };
\ No newline at end of file
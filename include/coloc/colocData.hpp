@@ -4,8 +4,11 @@
 #pragma once
 
 #include "openMVG.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -25,14 +28,22 @@ namespace coloc
     typedef std::map<Pair, RelativePose_Info> InterPoseMap;
     typedef SfM_Data Scene;
     typedef cameras::IntrinsicBase Camera;
+	typedef image::Image<unsigned char> GrayImage;
+
+	class colocData;
+	// Published map; never modified after publication, readers hold on to it for as long as they need
+	typedef std::shared_ptr<const colocData> MapSnapshot;
 
 	struct DetectorOptions {
 		float scale_factor;
 		uint8_t scale_levels;
 		unsigned int width;
 		unsigned int height;
-		unsigned int maxkp;
+		unsigned int maxkp;			// keypoint budget per image, 0 keeps every keypoint
 		uint8_t thresh;
+		unsigned int budget_grid = 8;	// the budget is spread over budget_grid x budget_grid cells
+		unsigned int target_kp = 0;		// per-drone keypoint count the threshold adapts to, 0 keeps thresh fixed
+		std::string feature_cache;		// directory of the on-disk feature cache (see FeatureCache), empty disables it
 	};
 
 	struct MatcherOptions {
@@ -41,6 +52,62 @@ namespace coloc
 		unsigned int maxkp;
 	};
 
+	// One drone's image as it moves through the detect -> match -> localize -> fuse stages
+	struct TrackingFrame {
+		int droneId;
+		unsigned int imageNumber;
+		std::string filename;
+		FeatureMap regions;
+		MapSnapshot map;
+		IndMatches mapMatches;
+		std::vector <uint32_t> inliers;
+		Pose3 pose;
+		Cov6 cov{};
+		float rmse = 10.0;
+		bool locStatus = EXIT_FAILURE;
+
+		TrackingFrame(int _droneId, unsigned int _imageNumber) : droneId(_droneId), imageNumber(_imageNumber) {}
+
+		AKAZE_Binary_Regions& query() { return *regions.at(droneId); }
+	};
+
+	// Snapshot of a drone pair taken by the tracker for inter-MAV estimation.
+	// It owns copies of both frames so tracking can move on while it is processed.
+	struct InterRequest {
+		int sourceId;
+		int destId;
+		unsigned int imageNumber;
+		std::chrono::steady_clock::time_point stamp;
+		FeatureMap regions;
+		std::string sourceFilename, destFilename;
+		Pose3 sourcePose;
+	};
+
+	// Relative estimate of destId computed from an InterRequest, waiting to be fused
+	struct InterEstimate {
+		int sourceId;
+		int destId;
+		unsigned int imageNumber;
+		std::chrono::steady_clock::time_point stamp;
+		Pose3 pose;
+		Cov6 cov{};
+		float rmse = 0.0;
+		bool status = EXIT_FAILURE;
+	};
+
+	// Frames and poses a map update is built from, captured when the update is requested
+	struct MapRequest {
+		std::vector <int> drones;
+		unsigned int imageNumber;
+		std::vector <Pose3> poses;
+	};
+
+	// Axis-aligned box around a group of map landmarks
+	struct LandmarkVolume {
+		Vec3 min;
+		Vec3 max;
+	};
+
 
     class colocData {
     public:
@@ -53,9 +120,11 @@ namespace coloc
 		std::unique_ptr<features::AKAZE_Binary_Regions> interMapRegions;
         std::vector <IndexT> mapRegionIdx;
 		std::vector <IndexT> interMapRegionIdx;
-		Camera* cam;
-		unsigned int numDrones;
-		unsigned int keyframeIdx;
+		// Bounding volumes of the landmarks, set on snapshots (see computeLandmarkVolumes)
+		std::vector <LandmarkVolume> landmarkVolumes;
+		Camera* cam = nullptr;
+		unsigned int numDrones = 0;
+		unsigned int keyframeIdx = 0;
 		std::vector <std::string> filenames;
 		std::vector <std::string> keyframeNames;
 
@@ -81,6 +150,62 @@ namespace coloc
 			return *this;
 		}
 
+		// Copies the map (scene, map descriptors and their landmark ids) into a new
+		// immutable snapshot; the working data can be modified again right after.
+		MapSnapshot snapshotMap() const
+		{
+			std::shared_ptr<colocData> map = std::make_shared<colocData>();
+			map->scene = this->scene;
+			if (this->mapRegions)
+				map->mapRegions.reset(new AKAZE_Binary_Regions(*this->mapRegions));
+			map->mapRegionIdx = this->mapRegionIdx;
+			map->keyframeNames = this->keyframeNames;
+			map->cam = this->cam;
+			map->numDrones = this->numDrones;
+			map->keyframeIdx = this->keyframeIdx;
+			map->landmarkVolumes = computeLandmarkVolumes(map->scene);
+			return map;
+		}
+
+		// Splits the bounding box of the landmarks into cells x cells x cells cells and returns
+		// the box around the landmarks of every non-empty cell, a tighter hull than one box
+		static std::vector <LandmarkVolume> computeLandmarkVolumes(const Scene &scene, unsigned int cells = 4)
+		{
+			std::vector <LandmarkVolume> volumes;
+			const Landmarks &landmarks = scene.GetLandmarks();
+			if (landmarks.empty())
+				return volumes;
+
+			Vec3 lo = landmarks.begin()->second.X, hi = lo;
+			for (const auto &landmark : landmarks) {
+				lo = lo.cwiseMin(landmark.second.X);
+				hi = hi.cwiseMax(landmark.second.X);
+			}
+			const Vec3 extent = (hi - lo).cwiseMax(Vec3::Constant(1e-9));
+
+			std::map <unsigned int, LandmarkVolume> cellVolumes;
+			for (const auto &landmark : landmarks) {
+				const Vec3 &X = landmark.second.X;
+				unsigned int cell = 0;
+				for (int axis = 0; axis < 3; ++axis) {
+					const unsigned int c = std::min(static_cast<unsigned int>((X[axis] - lo[axis]) / extent[axis] * cells), cells - 1);
+					cell = cell * cells + c;
+				}
+				auto it = cellVolumes.find(cell);
+				if (it == cellVolumes.end())
+					cellVolumes.emplace(cell, LandmarkVolume{ X, X });
+				else {
+					it->second.min = it->second.min.cwiseMin(X);
+					it->second.max = it->second.max.cwiseMax(X);
+				}
+			}
+
+			volumes.reserve(cellVolumes.size());
+			for (const auto &cellVolume : cellVolumes)
+				volumes.push_back(cellVolume.second);
+			return volumes;
+		}
+
 		bool setCameraIntrinsics(Mat3 &K, Vec3 &dist, std::pair<int, int> &imageSize)
 		{
 			const openMVG::cameras::Pinhole_Intrinsic_Radial_K3 cam(imageSize.first, imageSize.second, (K)(0, 0), (K)(0, 2), (K)(1, 2), dist[0], dist[1], dist[2]);
@@ -93,8 +218,6 @@ namespace coloc
 			std::vector <IndexT> *indexes;
 			std::unique_ptr<features::AKAZE_Binary_Regions> *features;
 
-			interMapRegionIdx.clear();
-
 			if (inter) {
 				map = &this->tempScene;
 				indexes = &this->interMapRegionIdx;
@@ -106,6 +229,7 @@ namespace coloc
 				features = &this->mapRegions;
 			}
 
+			indexes->clear();
 			features->reset(new AKAZE_Binary_Regions);
 
 			for (const auto &landmark : map->GetLandmarks()) {
@@ -4,6 +4,7 @@
 #include "coloc/FeatureMatcher.hpp"
 
 #include "coloc/CPUDetector.hpp"
+#include "coloc/CPUKoralDetector.hpp"
 #include "coloc/GPUDetector.hpp"
 
 #include "coloc/colocParams.hpp"
@@ -19,7 +20,7 @@ namespace coloc
 	class Interface
 	{
 	public:
-		Interface(DetectorOptions &opts_, colocParams &params_, colocData &data_) : detector(opts_)
+		Interface(DetectorOptions &opts_, colocParams &params_, colocData &data_) : cachedFeatures(!opts_.feature_cache.empty()), detector(opts_)
 		{
 			this->params = &params_;
 			this->data = &data_;
@@ -27,15 +28,28 @@ namespace coloc
 
 		unsigned int imageNumber = 0;
 
+		// Where the next frame of each drone is detected, see DetectionROI
+		DetectionWindows detectionWindows;
+
 		virtual void processImageSingle(int &id) = 0;
+		virtual void processImageSingle(int &id, unsigned int number, FeatureMap &regions, std::string &filename) = 0;
 		virtual void processImages(std::vector <int>& droneIds) = 0;
 
+		// Reads drone id's frame 'number', for callers that need its pixels as well as its features
+		virtual bool readFrame(int id, unsigned int number, GrayImage &image, std::string &filename) = 0;
+		// Detects an image read with readFrame into caller-owned regions
+		virtual void processImageSingle(int id, FeatureMap &regions, const GrayImage &image) = 0;
+
 	protected:
 		DetectorOptions *opts;
 		colocParams *params;
 		colocData *data;
+		// Whether the detector keeps a FeatureCache
+		const bool cachedFeatures;
 #ifdef USE_CUDA
 		FeatureDetector <bool, GPUDetector> detector;
+#elif defined(USE_KORAL_CPU)
+		FeatureDetector <bool, CPUKoralDetector> detector;
 #else
 		FeatureDetector <bool, CPUDetector> detector;
 #endif
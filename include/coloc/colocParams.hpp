@@ -29,6 +29,69 @@ namespace coloc
 		DetectorOptions detectorOptions;
 		MatcherOptions matcherOptions;
 
+		// Threads used for computation by all stages together (see ThreadPool); 0 uses every hardware thread
+		unsigned int numThreads = 0;
+
+		// Run detection, map matching and PnP for all drones concurrently
+		bool parallelIntra = true;
+
+		// Overlap detection, matching, localization and fusion of consecutive frames
+		// in separate stages connected by queues of pipelineDepth frames
+		bool pipelined = false;
+		unsigned int pipelineDepth = 2;
+
+		// Compute inter-MAV estimates on a background worker instead of inline
+		bool asyncInter = true;
+
+		// (source, dest) drone pairs used for inter-MAV estimation; empty pairs drone 0 with every other drone
+		std::vector <Pair> interPairs;
+
+		// Run inter-MAV estimation on every interPeriod-th frame; 0 runs it on the first frame only
+		unsigned int interPeriod = 0;
+
+		// At most interMaxPairs of the pairs above, the most useful ones, are processed per cycle,
+		// and fewer if their measured cost exceeds interBudgetMs. Cameras further apart than
+		// overlapDistance (map units) are predicted to share less than half of their view.
+		unsigned int interMaxPairs = 2;
+		double interBudgetMs = 500.0;
+		double overlapDistance = 5.0;
+
+		// Build map updates on a background worker; trackers keep using the previous map until it is published
+		bool asyncMapUpdate = true;
+
+		// Deadline mode: frames arrive every framePeriodMs and must be done within latencyBudgetMs
+		// of arriving. Stale frames are skipped in favour of the newest one, and frames that would
+		// finish late are dropped.
+		bool deadlineMode = false;
+		double framePeriodMs = 66.0;
+		double latencyBudgetMs = 100.0;
+
+		// ROI detection: while a drone is tracked, its next frame is only detected where the map
+		// reprojects from the pose its filter predicts, grown by roiMargin pixels. The frame after
+		// a tracking failure is detected in full.
+		bool roiDetection = false;
+		int roiMargin = 40;
+
+		// KLT tracking: between keyframes, the inliers of a drone's last localized frame are followed
+		// with pyramidal Lucas-Kanade optical flow and its pose is computed from them, without
+		// detection and map matching. A frame becomes a keyframe, detected and matched in full, when
+		// fewer than kltMinTracks inliers are left, every kltKeyframeInterval frames, and when the
+		// drone's features are needed for inter-MAV estimation or a map update. Not used in pipelined mode.
+		bool kltTracking = false;
+		unsigned int kltMinTracks = 60;
+		unsigned int kltKeyframeInterval = 10;
+
+		// Frames of every drone read and decoded ahead of detection, on prefetchThreads background
+		// threads (see FramePrefetcher); 0 reads each frame when it is detected
+		unsigned int prefetchDepth = 2;
+		unsigned int prefetchThreads = 2;
+
+		// An initial map with fewer landmarks is rejected and built again from later frames
+		unsigned int minMapLandmarks = 50;
+
+		// Number of frames to process per drone
+		unsigned int numFrames = 1;
+
         colocParams(const std::vector <Mat3> &_K,
                     const std::vector <Vec3> &_dist, const char &_model, const std::pair<size_t, size_t> &_imageSize,
                     const std::string &_imageFolder, DetectorOptions _detectorOptions, MatcherOptions _matcherOptions) :
@@ -27,7 +27,7 @@ namespace coloc
 	class Utils
 	{
 	public:
-		double computeScaleDifference(Scene &scene1, std::vector <IndexT> &idx1, Scene &scene2, std::vector <IndexT> &idx2, std::vector<IndMatch> commonFeatures);
+		double computeScaleDifference(const Scene &scene1, const std::vector <IndexT> &idx1, const Scene &scene2, const std::vector <IndexT> &idx2, std::vector<IndMatch> commonFeatures);
 		bool matchSceneWithMap(Scene& scene);
 		bool rescaleMap(Scene& scene, double scale);
 		int drawFeaturePoints(std::string& imageName, features::PointFeatures points);
@@ -60,6 +60,28 @@ namespace coloc
 			return exhaustivePairs(numImages);
 		}
 
+		// Valid inter-MAV pairs out of the requested ones. Without a request, drone 0 is paired
+		// with every other drone, so the number of pairs grows linearly with the number of drones.
+		static std::vector <Pair> interPairs(const std::vector <Pair>& requested, unsigned int numDrones)
+		{
+			std::vector <Pair> pairs;
+			if (requested.empty()) {
+				for (IndexT i = 1; i < numDrones; ++i)
+					pairs.push_back({ 0, i });
+				return pairs;
+			}
+
+			for (const Pair& pair : requested) {
+				if (pair.first >= numDrones || pair.second >= numDrones || pair.first == pair.second) {
+					std::cout << "Ignoring invalid inter-MAV pair " << pair.first << " & " << pair.second << std::endl;
+					continue;
+				}
+				if (std::find(pairs.begin(), pairs.end(), pair) == pairs.end())
+					pairs.push_back(pair);
+			}
+			return pairs;
+		}
+
 		static cv::Mat rot2euler(const cv::Mat & rotationMatrix)
 		{
 			cv::Mat euler(3, 1, CV_64F);
@@ -181,7 +203,7 @@ namespace coloc
 		return false;
 	}
 
-	double Utils::computeScaleDifference(Scene &scene1, std::vector <IndexT> &idx1, Scene &scene2, std::vector <IndexT> &idx2, std::vector<IndMatch> commonFeatures)
+	double Utils::computeScaleDifference(const Scene &scene1, const std::vector <IndexT> &idx1, const Scene &scene2, const std::vector <IndexT> &idx2, std::vector<IndMatch> commonFeatures)
 	{
 		if (commonFeatures.empty()) {
 			std::cout << "No common features between the maps." << std::endl;
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <fstream>
+#include <mutex>
 #include "colocData.hpp"
 #include "colocParams.hpp"
 
@@ -17,6 +18,9 @@ namespace coloc
 
 	private:
 		void convertAnglesForLogging(Vec3& angles);
+
+		// Pose logs are appended to from several drones at once
+		std::mutex fileMutex;
 	};
 
 	bool Logger::createLogFile(std::string& filename)
@@ -68,6 +72,7 @@ namespace coloc
 
 	bool Logger::logPoseCovtoFile(int idx, int source, int dest, Pose3& pose, Cov6& cov, float& rmse, int& nTracks, std::string& filename)
 	{
+		std::lock_guard<std::mutex> lock(fileMutex);
 		std::ofstream file;
 
 		Vec3 position = pose.center();
@@ -101,6 +106,7 @@ namespace coloc
 
 	bool Logger::logPosetoPLY(Pose3& pose, std::string& filename)
 	{
+		std::lock_guard<std::mutex> lock(fileMutex);
 		std::ofstream stream(filename.c_str(), std::ios::out | std::ios::app);
 		if (!stream.is_open())
 			return false;
@@ -78,7 +78,9 @@ int main(int argc, char **argv)
 		Dopts.maxkp = 5000;
 		Dopts.scale_factor = 1.2;
 		Dopts.scale_levels = 8;
-		Dopts.thresh = 40;
+		Dopts.thresh = 40;			// starting point, adapted per drone to hold target_kp
+		Dopts.target_kp = 2000;
+		Dopts.feature_cache = imageFolder + "featureCache";	// replays of the dataset reuse the features of earlier runs
 
 		Mopts.distRatio = 0.8;
 		Mopts.maxkp = 5000;
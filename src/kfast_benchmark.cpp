@@ -0,0 +1,91 @@
+// Throughput of the KFAST code paths on this host, single threaded with non-max suppression,
+// on synthetic 640x480 and 1280x720 frames.
+//
+//   kfast_benchmark [threshold] [seconds per run]
+
+#include "coloc/KFAST.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std::chrono;
+
+// Smooth shading, a checkerboard for strong corners and sensor noise
+static std::vector<uint8_t> makeFrame(int width, int height)
+{
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> noise(-12, 12);
+	// Padded for the vector loads past the last pixel, like ImagePyramid
+	std::vector<uint8_t> frame(static_cast<size_t>(width) * height + 64);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const double shade = 60.0 * std::sin(x * 0.021) * std::cos(y * 0.017);
+			const int board = ((x / 24 + y / 24) % 2) * 70;
+			const int value = static_cast<int>(90.0 + shade) + board + noise(rng);
+			frame[y * width + x] = static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+		}
+	}
+	return frame;
+}
+
+static bool sameKeypoints(const std::vector<Keypoint>& a, const std::vector<Keypoint>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].score != b[i].score)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const uint8_t threshold = static_cast<uint8_t>(argc > 1 ? atoi(argv[1]) : 20);
+	const double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+
+	const KORAL_ISA best = KORAL_detectISA();
+	printf("Host supports %s, KFAST threshold %d\n\n", KORAL_isaName(best), threshold);
+
+	const int sizes[2][2] = { { 640, 480 }, { 1280, 720 } };
+	for (const auto& size : sizes) {
+		const int width = size[0], height = size[1];
+		const std::vector<uint8_t> frame = makeFrame(width, height);
+
+		std::vector<Keypoint> reference;
+		_KFAST<true, true, true>(frame.data(), width, 0, height, width, reference, threshold, KORAL_ISA::Scalar);
+		printf("%dx%d, %zu keypoints\n", width, height, reference.size());
+
+		double avx2Rate = 0.0;
+		for (int level = static_cast<int>(KORAL_ISA::Scalar); level <= static_cast<int>(best); ++level) {
+			const KORAL_ISA isa = static_cast<KORAL_ISA>(level);
+			std::vector<Keypoint> kps;
+
+			int runs = 0;
+			const high_resolution_clock::time_point t1 = high_resolution_clock::now();
+			high_resolution_clock::time_point t2;
+			do {
+				kps.clear();
+				_KFAST<true, true, true>(frame.data(), width, 0, height, width, kps, threshold, isa);
+				++runs;
+				t2 = high_resolution_clock::now();
+			} while (duration_cast<duration<double>>(t2 - t1).count() < seconds);
+
+			const double elapsed = duration_cast<duration<double>>(t2 - t1).count();
+			const double rate = static_cast<double>(width) * height * runs / elapsed;
+			if (isa == KORAL_ISA::AVX2)
+				avx2Rate = rate;
+
+			printf("  %-8s %8.1f Mpixel/s  %7.3f ms/frame", KORAL_isaName(isa), rate * 1e-6, 1e3 * elapsed / runs);
+			if (avx2Rate > 0.0)
+				printf("  %.2fx AVX2", rate / avx2Rate);
+			printf("%s\n", sameKeypoints(kps, reference) ? "" : "  KEYPOINTS DIFFER");
+		}
+		printf("\n");
+	}
+	return EXIT_SUCCESS;
+}